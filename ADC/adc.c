@@ -14,6 +14,86 @@
 #include <avr/io.h>
 #include <stdbool.h>
 #include "adc.h"
+#if USE_ADC_IN_INTERRUPT_MODE
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
+#endif
+
+/* Copy of the last value written to ADMUX. Selecting the channel that is
+ * already set is then just a compare, no read-modify-write of the register.
+ * adc_discard_next is set when the channel or the reference changed and the
+ * next conversion is thrown away by the users that care about settling.
+ */
+static uint8_t adc_admux_shadow;
+static volatile bool adc_discard_next;
+
+#if USE_ADC_IN_INTERRUPT_MODE
+/* Modes of the interrupt driven engine, decides what the ADC ISR does with a
+ * conversion result
+ */
+typedef enum adc_engine_mode
+{
+    ADC_ENGINE_IDLE,
+    ADC_ENGINE_SINGLE,
+    ADC_ENGINE_SCAN,
+    ADC_ENGINE_STREAM,
+    ADC_ENGINE_OVERSAMPLE,
+    ADC_ENGINE_ASYNC
+}ADC_ENGINE_MODE;
+
+static volatile uint8_t adc_engine_mode = ADC_ENGINE_IDLE;
+/* Result of a single conversion done through the ISR */
+static volatile uint16_t adc_single_result;
+
+/* Asynchronous conversion state */
+static volatile uint8_t adc_async_channel;
+static volatile ADC_CALLBACK adc_async_callback;
+static volatile uint16_t adc_async_result;
+static volatile bool adc_async_ready;
+
+/* Scan engine state. The ISR always writes into adc_scan_buffer[adc_scan_back]
+ * and flips adc_scan_back when a scan is complete, so the other half holds the
+ * last complete scan. adc_scan_sequence counts the published scans and lets
+ * the reader detect a swap while it is copying.
+ */
+static uint8_t adc_scan_channels[MAX_NO_OF_SCAN_CHANNELS];
+static uint8_t adc_scan_no_of_channels;
+static volatile uint8_t adc_scan_index;
+static volatile bool adc_scan_continuous;
+/* Set while scanning in noise reduction mode, the next conversion is then
+ * started by going back to sleep instead of setting ADSC
+ */
+static volatile bool adc_scan_sleep;
+static volatile uint16_t adc_scan_buffer[2][MAX_NO_OF_SCAN_CHANNELS];
+static volatile uint8_t adc_scan_back;
+static volatile uint8_t adc_scan_sequence;
+static uint8_t adc_scan_last_read;
+
+#if (ADC_STREAM_BUFFER_SIZE & (ADC_STREAM_BUFFER_SIZE - 1)) || (ADC_STREAM_BUFFER_SIZE > 128)
+#error "ADC_STREAM_BUFFER_SIZE has to be a power of two not more than 128"
+#endif
+#define ADC_STREAM_BUFFER_MASK (ADC_STREAM_BUFFER_SIZE - 1)
+
+/* Auto trigger ring buffer. adc_stream_head is only written by the ISR and
+ * adc_stream_tail only by the reader. Both run freely and are masked when
+ * indexing, so head - tail is the fill level.
+ */
+static volatile uint16_t adc_stream_buffer[ADC_STREAM_BUFFER_SIZE];
+static volatile uint8_t adc_stream_head;
+static volatile uint8_t adc_stream_tail;
+static volatile uint16_t adc_stream_overruns;
+/* TIFR bit of the timer used as trigger source, 0 for the other sources */
+static uint8_t adc_stream_trigger_flag;
+
+/* Oversampling state, the accumulator is only touched by the ISR while a
+ * reading is in progress
+ */
+static uint32_t adc_oversample_accumulator;
+static volatile uint16_t adc_oversample_remaining;
+static uint8_t adc_oversample_extra_bits;
+static volatile uint16_t adc_oversample_result;
+#endif
 
 /*
  * Function: AdcInit()
@@ -24,13 +104,11 @@
  */
 
 /* Implementation note :
-   Also things like the auto trigger and interrupt handling is still missing
-   may be that can be implemented in the future
-   An additional thing that needs implementing is the differential channel
-   selection with adjustable gain
-   for this implementation the positive and the negative channel number can be
-   taken
-   as input parameter along with the gain required !!
+   Interrupt handling and the auto trigger are done by the engine at the end
+   of this file, see AdcScanStart() and AdcStreamStart()
+   The differential channels with adjustable gain are read with
+   ReadAdcDifferential(), the ADC_DIFF_CHANNEL enum gives the positive and the
+   negative channel along with the gain
 */
 void AdcInit(REFERENCE_VOLTAGE ref_volts, ADC_CLK_PRESCALE adc_prescale,
              bool left_justified, bool interrut_enabled/*,auto_trigger_enable*/)
@@ -46,7 +124,9 @@ void AdcInit(REFERENCE_VOLTAGE ref_volts, ADC_CLK_PRESCALE adc_prescale,
      * is good enough.This pre-scaling factor is kept as default if nothing or
      * wrong prescale is provided which should not be the case as it needs and
      * enum which has to have a value which is defined.
+     * The AUTO values use the prescale worked out from F_CPU in adc.h
      */
+    ADCSRA &= ~((1<<ADPS2)|(1<<ADPS1)|(1<<ADPS0));
     switch(adc_prescale)
     {
         case CLK_DIV_BY_2 :
@@ -70,6 +150,16 @@ void AdcInit(REFERENCE_VOLTAGE ref_volts, ADC_CLK_PRESCALE adc_prescale,
         case CLK_DIV_BY_128 :
             ADCSRA |= (7<<ADPS0);
             break;
+#ifdef F_CPU
+        case CLK_DIV_AUTO :
+            ADCSRA |= (ADC_AUTO_PRESCALE<<ADPS0);
+            break;
+        case CLK_DIV_AUTO_FAST_8_BIT :
+            ADCSRA |= (ADC_FAST8_PRESCALE<<ADPS0);
+            /* Only ADCH is read in this mode */
+            left_justified = true;
+            break;
+#endif
         default:
             ADCSRA |= (7<<ADPS0);
             break;
@@ -103,6 +193,43 @@ void AdcInit(REFERENCE_VOLTAGE ref_volts, ADC_CLK_PRESCALE adc_prescale,
         ADMUX |= (1<<ADLAR); // set the ADLAR bit
     else
         ADMUX &= ~(1<<ADLAR); // clear the ADLAR bit
+
+    /* Remember a change of reference so the next conversion can be dropped */
+    if ((ADMUX ^ adc_admux_shadow) & ((1<<REFS1)|(1<<REFS0)))
+    {
+        adc_discard_next = true;
+    }
+    adc_admux_shadow = ADMUX;
+
+#if USE_ADC_IN_INTERRUPT_MODE
+    if (interrut_enabled)
+    {
+        AdcEnableInterrupt();
+    }
+#endif
+}
+
+/*
+ * Function: adc_select_channel()
+ *
+ * Description: Writes the channel (single ended or differential) into the MUX
+ * bits of ADMUX leaving the reference and the adjustment bits as they are.
+ * Nothing is written if the channel is already selected.
+ *
+ * Returns: true if the channel was changed
+ */
+static bool adc_select_channel(uint8_t channel)
+{
+    uint8_t admux = (adc_admux_shadow & 0xE0) | (channel & ADC_MUX_MASK);
+
+    if (admux == adc_admux_shadow)
+    {
+        return false;
+    }
+    ADMUX = admux;
+    adc_admux_shadow = admux;
+    adc_discard_next = true;
+    return true;
 }
 
 uint16_t ReadAdc(uint8_t channel, bool shift_by_6_to_right)
@@ -110,20 +237,20 @@ uint16_t ReadAdc(uint8_t channel, bool shift_by_6_to_right)
     uint16_t adc_value;
 
     channel = (channel & MAX_NO_OF_ADC_CHANNELS);
-    /* Mask the higher nibble in order to prevent it from getting overwritten
-     * and clear the channel in order to write the new one
-     */
-    ADMUX &= 0xE0;
-    SetChannel(channel);
+    /* Only the MUX bits are changed and only if the channel is a new one */
+    adc_select_channel(channel);
 
-    /*Start the conversion and wait until ADIF is high (else use interrupts)*/
+    /* Start the conversion and wait until ADSC goes low again. ADIF is not
+     * polled as it gets cleared by the ISR when the interrupt is enabled
+     */
     StartAdcConversion();
-    while(!(ADCSRA & (1<<ADIF)));
+    while(ADCSRA & (1<<ADSC));
 
     /* Get data from the ADCH and ADCL register
      * This can be directly accessed by using ADC
      */
     adc_value = ADC;
+    adc_discard_next = false;
 
     /* Write one back to the ADIF bit to clear it */
     AdcReset();
@@ -137,8 +264,682 @@ uint16_t ReadAdc(uint8_t channel, bool shift_by_6_to_right)
     }
 }
 
+/*
+ * Function: ReadAdcFast8()
+ *
+ * Description: Reads the channel passed in and returns only ADCH. For more
+ * details see adc.h
+ *
+ * Returns: The upper 8 bits of the conversion
+ */
+uint8_t ReadAdcFast8(uint8_t channel)
+{
+    uint8_t adc_value;
+
+    adc_select_channel(channel & MAX_NO_OF_ADC_CHANNELS);
+
+    StartAdcConversion();
+    while(ADCSRA & (1<<ADSC));
+
+    adc_value = ADCH;
+    adc_discard_next = false;
+    AdcReset();
+    return adc_value;
+}
+
+/*
+ * Function: ReadAdcDifferential()
+ *
+ * Description: Reads the differential channel passed in. When the channel or
+ * the reference changed a first conversion is done and thrown away to give
+ * the gain stage time to settle. For more details see adc.h
+ *
+ * Returns: The signed result of the conversion
+ */
+int16_t ReadAdcDifferential(ADC_DIFF_CHANNEL channel)
+{
+    /* Let a conversion started by someone else finish first */
+    while(ADCSRA & (1<<ADSC));
+
+    adc_select_channel(channel);
+    if (adc_discard_next)
+    {
+        adc_discard_next = false;
+        StartAdcConversion();
+        while(ADCSRA & (1<<ADSC));
+    }
+
+    StartAdcConversion();
+    while(ADCSRA & (1<<ADSC));
+    AdcReset();
+
+    return AdcDifferentialValue(ADC);
+}
+
+/*
+ * Function: AdcDifferentialValue()
+ *
+ * Description: Sign extends the 10 bit two's complement result of a
+ * differential conversion. For more details see adc.h
+ *
+ * Returns: The signed value (-512 to 511)
+ */
+int16_t AdcDifferentialValue(uint16_t adc_value)
+{
+    if (ADMUX & (1<<ADLAR))
+    {
+        /* Left adjusted, the sign is already in bit 15 */
+        return ((int16_t)adc_value >> 6);
+    }
+    if (adc_value & 0x0200)
+    {
+        adc_value |= 0xFC00;
+    }
+    return (int16_t)adc_value;
+}
+
 void DisableInternalADC()
 {
     /* Clearing the ADC Enable bit would disable the adc */
     ADCSRA &= ~(1<<ADEN);
 }
+
+#if USE_ADC_IN_INTERRUPT_MODE
+/*
+ * Function: adc_scan_isr()
+ *
+ * Description: Stores the result of the current scan channel and starts the
+ * conversion of the next one. Called from the ADC ISR
+ *
+ * Returns: Nothing
+ */
+static inline void adc_scan_isr(uint16_t adc_value)
+{
+    uint8_t index = adc_scan_index;
+
+    adc_scan_buffer[adc_scan_back][index] = adc_value;
+    index++;
+
+    if (index >= adc_scan_no_of_channels)
+    {
+        /* Publish the complete scan by swapping the buffers */
+        adc_scan_back ^= 1;
+        adc_scan_sequence++;
+        index = 0;
+
+        if (!adc_scan_continuous)
+        {
+            adc_scan_index = 0;
+            adc_engine_mode = ADC_ENGINE_IDLE;
+            return;
+        }
+    }
+
+    adc_scan_index = index;
+    adc_select_channel(adc_scan_channels[index]);
+    if (!adc_scan_sleep)
+    {
+        StartAdcConversion();
+    }
+}
+
+/*
+ * Function: AdcScanInit()
+ *
+ * Description: Copies the channel list used by the scan engine. For more
+ * details see adc.h
+ *
+ * Returns: Nothing
+ */
+void AdcScanInit(const uint8_t *channels, uint8_t no_of_channels)
+{
+    uint8_t i;
+
+    if (no_of_channels > MAX_NO_OF_SCAN_CHANNELS)
+    {
+        no_of_channels = MAX_NO_OF_SCAN_CHANNELS;
+    }
+
+    for (i = 0; i < no_of_channels; i++)
+    {
+        adc_scan_channels[i] = channels[i] & ADC_MUX_MASK;
+    }
+    adc_scan_no_of_channels = no_of_channels;
+}
+
+/*
+ * Function: AdcScanStart()
+ *
+ * Description: Starts the conversion of the first channel in the list, the
+ * rest of the scan is done by the ADC ISR. For more details see adc.h
+ *
+ * Returns: Nothing
+ */
+void AdcScanStart(bool continuous)
+{
+    if (adc_scan_no_of_channels == 0)
+    {
+        return;
+    }
+
+    /* Let a conversion started by someone else finish first */
+    while(ADCSRA & (1<<ADSC));
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_scan_continuous = continuous;
+        adc_scan_sleep = false;
+        adc_scan_index = 0;
+        adc_engine_mode = ADC_ENGINE_SCAN;
+        adc_select_channel(adc_scan_channels[0]);
+        DisableAutoTrigger();
+        AdcEnableInterrupt();
+        StartAdcConversion();
+    }
+}
+
+/*
+ * Function: AdcScanStop()
+ *
+ * Description: Stops the scan engine. For more details see adc.h
+ *
+ * Returns: Nothing
+ */
+void AdcScanStop()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_scan_continuous = false;
+        adc_scan_index = 0;
+        adc_engine_mode = ADC_ENGINE_IDLE;
+    }
+}
+
+bool AdcScanIsBusy()
+{
+    return (adc_engine_mode == ADC_ENGINE_SCAN);
+}
+
+/*
+ * Function: AdcScanGetSnapshot()
+ *
+ * Description: Copies the last published scan. The copy is retried if the
+ * ISR swapped the buffers while copying. For more details see adc.h
+ *
+ * Returns: true if the scan was not read before
+ */
+bool AdcScanGetSnapshot(uint16_t *samples)
+{
+    uint8_t sequence;
+    uint8_t front;
+    uint8_t i;
+    bool is_new;
+
+    do
+    {
+        sequence = adc_scan_sequence;
+        front = adc_scan_back ^ 1;
+        for (i = 0; i < adc_scan_no_of_channels; i++)
+        {
+            samples[i] = adc_scan_buffer[front][i];
+        }
+    } while (sequence != adc_scan_sequence);
+
+    is_new = (sequence != adc_scan_last_read);
+    adc_scan_last_read = sequence;
+    return is_new;
+}
+
+/*
+ * Function: adc_stream_isr()
+ *
+ * Description: Pushes a sample into the auto trigger ring buffer and clears
+ * the timer flag so the next timer event triggers again. Called from the ADC
+ * ISR
+ *
+ * Returns: Nothing
+ */
+static inline void adc_stream_isr(uint16_t adc_value)
+{
+    uint8_t head = adc_stream_head;
+
+    if ((uint8_t)(head - adc_stream_tail) >= ADC_STREAM_BUFFER_SIZE)
+    {
+        if (adc_stream_overruns != 0xFFFF)
+        {
+            adc_stream_overruns++;
+        }
+    }
+    else
+    {
+        adc_stream_buffer[head & ADC_STREAM_BUFFER_MASK] = adc_value;
+        adc_stream_head = head + 1;
+    }
+
+    /* Writing one clears the flag, the other flags are left alone */
+    if (adc_stream_trigger_flag)
+    {
+        TIFR = adc_stream_trigger_flag;
+    }
+}
+
+/*
+ * Function: AdcStreamStart()
+ *
+ * Description: Sets up the auto trigger for the channel and source passed
+ * in. For more details see adc.h
+ *
+ * Returns: Nothing
+ */
+void AdcStreamStart(uint8_t channel, ADC_TRIGGER_SOURCE trigger)
+{
+    switch (trigger)
+    {
+        case TRIGGER_TIMER_0_COMPARE_MATCH :
+            adc_stream_trigger_flag = (1<<OCF0);
+            break;
+        case TRIGGER_TIMER_0_OVERFLOW :
+            adc_stream_trigger_flag = (1<<TOV0);
+            break;
+        case TRIGGER_TIMER_1_COMPARE_MATCH_B :
+            adc_stream_trigger_flag = (1<<OCF1B);
+            break;
+        case TRIGGER_TIMER_1_OVERFLOW :
+            adc_stream_trigger_flag = (1<<TOV1);
+            break;
+        case TRIGGER_TIMER_1_CAPTURE_EVENT :
+            adc_stream_trigger_flag = (1<<ICF1);
+            break;
+        default:
+            adc_stream_trigger_flag = 0;
+            break;
+    }
+
+    /* Let a conversion started by someone else finish first */
+    while(ADCSRA & (1<<ADSC));
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_stream_head = 0;
+        adc_stream_tail = 0;
+        adc_stream_overruns = 0;
+        adc_engine_mode = ADC_ENGINE_STREAM;
+        adc_select_channel(channel);
+        SetAutoTriggerSource(trigger);
+        /* Clear a pending trigger flag so the first sample is taken on the
+         * next event and not right away
+         */
+        if (adc_stream_trigger_flag)
+        {
+            TIFR = adc_stream_trigger_flag;
+        }
+        AdcEnableInterrupt();
+        EnableAutoTrigger();
+    }
+
+    /* In free running mode the first conversion has to be started by hand */
+    if (trigger == TRIGGER_FREE_RUNNING)
+    {
+        StartAdcConversion();
+    }
+}
+
+/*
+ * Function: AdcStreamStop()
+ *
+ * Description: Disables the auto trigger. For more details see adc.h
+ *
+ * Returns: Nothing
+ */
+void AdcStreamStop()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        DisableAutoTrigger();
+        adc_engine_mode = ADC_ENGINE_IDLE;
+    }
+}
+
+uint8_t AdcStreamAvailable()
+{
+    return (uint8_t)(adc_stream_head - adc_stream_tail);
+}
+
+/*
+ * Function: AdcStreamRead()
+ *
+ * Description: Copies the samples waiting in the ring buffer. The slots are
+ * handed back to the ISR only after copying by moving the tail. For more
+ * details see adc.h
+ *
+ * Returns: The number of samples copied
+ */
+uint8_t AdcStreamRead(uint16_t *samples, uint8_t max_samples)
+{
+    uint8_t tail = adc_stream_tail;
+    uint8_t count = (uint8_t)(adc_stream_head - tail);
+    uint8_t i;
+
+    if (count > max_samples)
+    {
+        count = max_samples;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        samples[i] = adc_stream_buffer[(uint8_t)(tail + i) & ADC_STREAM_BUFFER_MASK];
+    }
+
+    adc_stream_tail = tail + count;
+    return count;
+}
+
+uint16_t AdcStreamOverruns()
+{
+    uint16_t overruns;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        overruns = adc_stream_overruns;
+    }
+    return overruns;
+}
+
+/*
+ * Function: adc_oversample_isr()
+ *
+ * Description: Adds the sample to the accumulator and either starts the next
+ * conversion or stores the decimated result. Called from the ADC ISR
+ *
+ * Returns: Nothing
+ */
+static inline void adc_oversample_isr(uint16_t adc_value)
+{
+    if (ADMUX & (1<<ADLAR))
+    {
+        adc_value >>= 6;
+    }
+    adc_oversample_accumulator += adc_value;
+
+    if (--adc_oversample_remaining == 0)
+    {
+        adc_oversample_result = (uint16_t)(adc_oversample_accumulator >> adc_oversample_extra_bits);
+        adc_engine_mode = ADC_ENGINE_IDLE;
+    }
+    else
+    {
+        StartAdcConversion();
+    }
+}
+
+/*
+ * Function: AdcOversampleStart()
+ *
+ * Description: Starts the first of the 4^extra_bits conversions, the rest is
+ * done by the ADC ISR. For more details see adc.h
+ *
+ * Returns: true if the reading was started
+ */
+bool AdcOversampleStart(uint8_t channel, uint8_t extra_bits)
+{
+    if ((extra_bits == 0) || (extra_bits > ADC_OVERSAMPLE_MAX_EXTRA_BITS) ||
+        (adc_engine_mode != ADC_ENGINE_IDLE))
+    {
+        return false;
+    }
+
+    /* Let a conversion started by someone else finish first */
+    while(ADCSRA & (1<<ADSC));
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_oversample_accumulator = 0;
+        /* 4^n = 2^(2n) */
+        adc_oversample_remaining = (uint16_t)1 << (2 * extra_bits);
+        adc_oversample_extra_bits = extra_bits;
+        adc_engine_mode = ADC_ENGINE_OVERSAMPLE;
+        adc_select_channel(channel);
+        DisableAutoTrigger();
+        AdcEnableInterrupt();
+        StartAdcConversion();
+    }
+    return true;
+}
+
+bool AdcOversampleIsBusy()
+{
+    return (adc_engine_mode == ADC_ENGINE_OVERSAMPLE);
+}
+
+uint16_t AdcOversampleResult()
+{
+    uint16_t result;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        result = adc_oversample_result;
+    }
+    return result;
+}
+
+uint16_t ReadAdcOversampled(uint8_t channel, uint8_t extra_bits)
+{
+    if (!AdcOversampleStart(channel, extra_bits))
+    {
+        return 0;
+    }
+    while (AdcOversampleIsBusy());
+    return AdcOversampleResult();
+}
+
+/*
+ * Function: adc_sleep_while_busy()
+ *
+ * Description: Puts the CPU into ADC Noise Reduction mode until the engine
+ * leaves the mode passed in. Entering the sleep mode starts a conversion if
+ * none is in progress. The check and the sleep instruction are done with
+ * interrupts disabled, sei() only takes effect after the following
+ * instruction so a wake up cannot be missed in between.
+ *
+ * Returns: Nothing
+ */
+static void adc_sleep_while_busy(uint8_t mode)
+{
+    set_sleep_mode(SLEEP_MODE_ADC);
+    for (;;)
+    {
+        cli();
+        if (adc_engine_mode != mode)
+        {
+            sei();
+            break;
+        }
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+    }
+}
+
+/*
+ * Function: ReadAdcSleep()
+ *
+ * Description: Reads the channel passed in while sleeping in ADC Noise
+ * Reduction mode. For more details see adc.h
+ *
+ * Returns: The value from the analog to digital conversion
+ */
+uint16_t ReadAdcSleep(uint8_t channel)
+{
+    /* Let a conversion started by someone else finish first */
+    while(ADCSRA & (1<<ADSC));
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_engine_mode = ADC_ENGINE_SINGLE;
+        adc_select_channel(channel);
+        DisableAutoTrigger();
+        AdcEnableInterrupt();
+    }
+
+    adc_sleep_while_busy(ADC_ENGINE_SINGLE);
+    return adc_single_result;
+}
+
+/*
+ * Function: AdcScanSleep()
+ *
+ * Description: Does one scan of the channel list while sleeping in ADC Noise
+ * Reduction mode. For more details see adc.h
+ *
+ * Returns: Nothing
+ */
+void AdcScanSleep()
+{
+    if (adc_scan_no_of_channels == 0)
+    {
+        return;
+    }
+
+    /* Let a conversion started by someone else finish first */
+    while(ADCSRA & (1<<ADSC));
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        adc_scan_continuous = false;
+        adc_scan_sleep = true;
+        adc_scan_index = 0;
+        adc_engine_mode = ADC_ENGINE_SCAN;
+        adc_select_channel(adc_scan_channels[0]);
+        DisableAutoTrigger();
+        AdcEnableInterrupt();
+    }
+
+    adc_sleep_while_busy(ADC_ENGINE_SCAN);
+}
+
+/*
+ * Function: adc_async_isr()
+ *
+ * Description: Drops the first conversion after a channel or reference change,
+ * otherwise stores the result and hands it to the callback. Called from the
+ * ADC ISR
+ *
+ * Returns: Nothing
+ */
+static inline void adc_async_isr(uint16_t adc_value)
+{
+    ADC_CALLBACK callback;
+
+    if (adc_discard_next)
+    {
+        adc_discard_next = false;
+        StartAdcConversion();
+        return;
+    }
+
+    adc_async_result = adc_value;
+    adc_async_ready = true;
+    adc_engine_mode = ADC_ENGINE_IDLE;
+
+    /* The engine is idle again, so the callback may start the next one */
+    callback = adc_async_callback;
+    if (callback)
+    {
+        callback(adc_async_channel, adc_value);
+    }
+}
+
+/*
+ * Function: AdcStartAsync()
+ *
+ * Description: Selects the channel and starts the conversion, the result is
+ * picked up by the ADC ISR. For more details see adc.h
+ *
+ * Returns: true if the conversion was started
+ */
+bool AdcStartAsync(uint8_t channel, ADC_CALLBACK callback)
+{
+    bool started = false;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if ((adc_engine_mode == ADC_ENGINE_IDLE) && !(ADCSRA & (1<<ADSC)))
+        {
+            adc_async_channel = channel & ADC_MUX_MASK;
+            adc_async_callback = callback;
+            adc_async_ready = false;
+            adc_engine_mode = ADC_ENGINE_ASYNC;
+            adc_select_channel(channel);
+            DisableAutoTrigger();
+            AdcEnableInterrupt();
+            StartAdcConversion();
+            started = true;
+        }
+    }
+    return started;
+}
+
+/*
+ * Function: AdcPoll()
+ *
+ * Description: Hands out the result of the last asynchronous conversion if
+ * it has not been picked up yet. For more details see adc.h
+ *
+ * Returns: true if a result was copied to value
+ */
+bool AdcPoll(uint16_t *value)
+{
+    bool ready;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ready = adc_async_ready;
+        if (ready)
+        {
+            *value = adc_async_result;
+            adc_async_ready = false;
+        }
+    }
+    return ready;
+}
+
+/*
+ * ADC conversion complete interrupt. Hands the result to whatever the engine
+ * is currently doing, a result arriving while idle is dropped.
+ */
+ISR(ADC_vect)
+{
+    uint16_t adc_value = ADC;
+
+    /* Any completed conversion settles the current channel, only the
+     * asynchronous mode looks at the flag itself
+     */
+    if (adc_engine_mode != ADC_ENGINE_ASYNC)
+    {
+        adc_discard_next = false;
+    }
+
+    switch (adc_engine_mode)
+    {
+        case ADC_ENGINE_SINGLE :
+            adc_single_result = adc_value;
+            adc_engine_mode = ADC_ENGINE_IDLE;
+            break;
+        case ADC_ENGINE_SCAN :
+            adc_scan_isr(adc_value);
+            break;
+        case ADC_ENGINE_STREAM :
+            adc_stream_isr(adc_value);
+            break;
+        case ADC_ENGINE_OVERSAMPLE :
+            adc_oversample_isr(adc_value);
+            break;
+        case ADC_ENGINE_ASYNC :
+            adc_async_isr(adc_value);
+            break;
+        default:
+            break;
+    }
+}
+#endif
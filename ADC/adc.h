@@ -52,14 +52,33 @@ ADIE Bit 3 ADC Interrupt Enable
 ADPS2:0 Bit 2:0 ADC Prescaler Select Bits
         These bits determine the division factor between the XTAL frequency and the input
         clock to the ADC.
+
+ * SFIOR
+---------------------------------------------------------------
+| ADTS2 | ADTS1 | ADTS0 |  -  | ACME | PUD | PSR2 | PSR10 |
+---------------------------------------------------------------
+ADTS2:0 Bit 7:5 ADC Auto Trigger Source
+        With ADATE set a conversion is started on the rising edge of the interrupt
+        flag of the selected source. The flag has to be cleared again before the
+        next event can start a conversion.
 */
 
 
 #ifndef _ADC_H_
 #define _ADC_H_
 
-#define USE_ADC_IN_INTERRUPT_MODE 0
+#define USE_ADC_IN_INTERRUPT_MODE 1
 #define MAX_NO_OF_ADC_CHANNELS 0x07
+/* All MUX4:0 bits, single ended and differential channels */
+#define ADC_MUX_MASK 0x1F
+/* Maximum number of entries in the channel list walked by the scan engine */
+#define MAX_NO_OF_SCAN_CHANNELS 8
+/* Size of the ring buffer filled by the auto triggered sampling, has to be a
+ * power of two and not more than 128 */
+#define ADC_STREAM_BUFFER_SIZE 32
+/* Largest number of extra bits the oversampling can be asked for, takes
+ * 4^6 = 4096 conversions */
+#define ADC_OVERSAMPLE_MAX_EXTRA_BITS 6
 
 typedef enum adc_clk_prescale
 {
@@ -69,9 +88,74 @@ typedef enum adc_clk_prescale
     CLK_DIV_BY_16,
     CLK_DIV_BY_32,
     CLK_DIV_BY_64,
-    CLK_DIV_BY_128
+    CLK_DIV_BY_128,
+    CLK_DIV_AUTO,           /* fastest for 10 bit accuracy, see ADC_AUTO_PRESCALE */
+    CLK_DIV_AUTO_FAST_8_BIT /* up to 1 MHz, forces left adjust, see ReadAdcFast8() */
 }ADC_CLK_PRESCALE;
 
+/* Prescaler picked from F_CPU at compile time for CLK_DIV_AUTO.
+ * For full 10 bit accuracy the ADC clock has to be between 50 kHz and 200 kHz,
+ * the smallest division keeping it at or below 200 kHz gives the highest rate.
+ * ADC_AUTO_PRESCALE is the value of the ADPS2:0 bits and a conversion takes
+ * 13 ADC clocks, which gives ADC_AUTO_SAMPLES_PER_SECOND.
+ */
+#ifdef F_CPU
+    #if (F_CPU / 2) <= 200000UL
+        #define ADC_AUTO_PRESCALE 1
+        #define ADC_AUTO_DIVISION 2UL
+    #elif (F_CPU / 4) <= 200000UL
+        #define ADC_AUTO_PRESCALE 2
+        #define ADC_AUTO_DIVISION 4UL
+    #elif (F_CPU / 8) <= 200000UL
+        #define ADC_AUTO_PRESCALE 3
+        #define ADC_AUTO_DIVISION 8UL
+    #elif (F_CPU / 16) <= 200000UL
+        #define ADC_AUTO_PRESCALE 4
+        #define ADC_AUTO_DIVISION 16UL
+    #elif (F_CPU / 32) <= 200000UL
+        #define ADC_AUTO_PRESCALE 5
+        #define ADC_AUTO_DIVISION 32UL
+    #elif (F_CPU / 64) <= 200000UL
+        #define ADC_AUTO_PRESCALE 6
+        #define ADC_AUTO_DIVISION 64UL
+    #else
+        #define ADC_AUTO_PRESCALE 7
+        #define ADC_AUTO_DIVISION 128UL
+    #endif
+
+    #define ADC_AUTO_CLK_HZ (F_CPU / ADC_AUTO_DIVISION)
+    #define ADC_AUTO_SAMPLES_PER_SECOND (ADC_AUTO_CLK_HZ / 13)
+
+    #if (F_CPU / 128) > 200000UL
+        #warning "F_CPU too high, the ADC clock is above 200 kHz even at /128"
+    #elif (F_CPU / ADC_AUTO_DIVISION) < 50000UL
+        #warning "F_CPU too low, the ADC clock is below 50 kHz even at /2"
+    #endif
+
+    /* Same for CLK_DIV_AUTO_FAST_8_BIT with the ADC clock at or below 1 MHz.
+     * Above 200 kHz only the upper 8 bits of the result are accurate.
+     */
+    #if (F_CPU / 2) <= 1000000UL
+        #define ADC_FAST8_PRESCALE 1
+        #define ADC_FAST8_DIVISION 2UL
+    #elif (F_CPU / 4) <= 1000000UL
+        #define ADC_FAST8_PRESCALE 2
+        #define ADC_FAST8_DIVISION 4UL
+    #elif (F_CPU / 8) <= 1000000UL
+        #define ADC_FAST8_PRESCALE 3
+        #define ADC_FAST8_DIVISION 8UL
+    #elif (F_CPU / 16) <= 1000000UL
+        #define ADC_FAST8_PRESCALE 4
+        #define ADC_FAST8_DIVISION 16UL
+    #else
+        #define ADC_FAST8_PRESCALE 5
+        #define ADC_FAST8_DIVISION 32UL
+    #endif
+
+    #define ADC_FAST8_CLK_HZ (F_CPU / ADC_FAST8_DIVISION)
+    #define ADC_FAST8_SAMPLES_PER_SECOND (ADC_FAST8_CLK_HZ / 13)
+#endif
+
 
 typedef enum reference_voltage
 {
@@ -81,18 +165,76 @@ typedef enum reference_voltage
 }REFERENCE_VOLTAGE;
 
 
+/* Values of the MUX4:0 bits for the differential channels, named as
+ * DIFF_<positive input>_<negative input>_GAIN_<gain>. The channels with the
+ * same input on both sides read the offset of the gain stage, which can be
+ * subtracted from the readings at that gain. The result of a differential
+ * conversion is a 10 bit two's complement value, see AdcDifferentialValue()
+ */
+typedef enum adc_diff_channel
+{
+    DIFF_ADC0_ADC0_GAIN_10X  = 0x08,
+    DIFF_ADC1_ADC0_GAIN_10X  = 0x09,
+    DIFF_ADC0_ADC0_GAIN_200X = 0x0A,
+    DIFF_ADC1_ADC0_GAIN_200X = 0x0B,
+    DIFF_ADC2_ADC2_GAIN_10X  = 0x0C,
+    DIFF_ADC3_ADC2_GAIN_10X  = 0x0D,
+    DIFF_ADC2_ADC2_GAIN_200X = 0x0E,
+    DIFF_ADC3_ADC2_GAIN_200X = 0x0F,
+    DIFF_ADC0_ADC1_GAIN_1X   = 0x10,
+    DIFF_ADC1_ADC1_GAIN_1X   = 0x11,
+    DIFF_ADC2_ADC1_GAIN_1X   = 0x12,
+    DIFF_ADC3_ADC1_GAIN_1X   = 0x13,
+    DIFF_ADC4_ADC1_GAIN_1X   = 0x14,
+    DIFF_ADC5_ADC1_GAIN_1X   = 0x15,
+    DIFF_ADC6_ADC1_GAIN_1X   = 0x16,
+    DIFF_ADC7_ADC1_GAIN_1X   = 0x17,
+    DIFF_ADC0_ADC2_GAIN_1X   = 0x18,
+    DIFF_ADC1_ADC2_GAIN_1X   = 0x19,
+    DIFF_ADC2_ADC2_GAIN_1X   = 0x1A,
+    DIFF_ADC3_ADC2_GAIN_1X   = 0x1B,
+    DIFF_ADC4_ADC2_GAIN_1X   = 0x1C,
+    DIFF_ADC5_ADC2_GAIN_1X   = 0x1D
+}ADC_DIFF_CHANNEL;
+
+/* Callback for the asynchronous conversions, called from the ADC ISR with
+ * the channel that was converted and the raw ADC register value */
+typedef void (*ADC_CALLBACK)(uint8_t channel, uint16_t value);
+
+/* Values of the ADTS2:0 bits in SFIOR */
+typedef enum adc_trigger_source
+{
+    TRIGGER_FREE_RUNNING = 0,
+    TRIGGER_ANALOG_COMPARATOR = 1,
+    TRIGGER_EXTERNAL_INT0 = 2,
+    TRIGGER_TIMER_0_COMPARE_MATCH = 3,
+    TRIGGER_TIMER_0_OVERFLOW = 4,
+    TRIGGER_TIMER_1_COMPARE_MATCH_B = 5,
+    TRIGGER_TIMER_1_OVERFLOW = 6,
+    TRIGGER_TIMER_1_CAPTURE_EVENT = 7
+}ADC_TRIGGER_SOURCE;
+
+
 /* MACROS */
 #define EnableAdc() ADCSRA |= (1<<ADEN);
 #define DisableAdc() DisableInternalADC();
 #define StartAdcConversion() ADCSRA |= (1<<ADSC);
+/* The library keeps a copy of ADMUX, write the channel with the functions
+ * below rather than with this macro once they are in use */
 #define SetChannel(channel) ADMUX |= (channel);
 #define AdcReset() ADCSRA |= (1<<ADIF);
+#define EnableAutoTrigger() ADCSRA |= (1<<ADATE);
+#define DisableAutoTrigger() ADCSRA &= ~(1<<ADATE);
+#define SetAutoTriggerSource(source) SFIOR = (SFIOR & 0x1F) | ((source)<<ADTS0);
 
 /* Usage for using the adc either in polling or using interrupt
-   TBD implement and test properly */
+   With USE_ADC_IN_INTERRUPT_MODE set the ADC conversion complete ISR is
+   defined in adc.c and drives the scan engine below. Global interrupts have
+   to be enabled (sei()) by the application for it to run */
 
 #if USE_ADC_IN_INTERRUPT_MODE
     #define AdcEnableInterrupt() ADCSRA |= (1<<ADIE);
+    #define AdcDisableInterrupt() ADCSRA &= ~(1<<ADIE);
 #endif
 
 /** Initialize the ADC
@@ -113,9 +255,204 @@ void AdcInit(REFERENCE_VOLTAGE ref_volts, ADC_CLK_PRESCALE adc_prescale,
  */
 uint16_t ReadAdc(uint8_t channel, bool true_value);
 
-#endif
+/** @brief  Read the upper 8 bits of a conversion
+ *
+ * Meant for AdcInit() with CLK_DIV_AUTO_FAST_8_BIT, where the result is left
+ * adjusted and only ADCH needs to be read. Gives up to
+ * ADC_FAST8_SAMPLES_PER_SECOND readings per second.
+ * @param channel The channel number of the ADC to read from (0-7)
+ * @return uint8_t the upper 8 bits of the conversion
+ */
+uint8_t ReadAdcFast8(uint8_t channel);
+
+/** @brief  Read a differential channel
+ *
+ * One conversion gives the difference between the two inputs with the gain
+ * of the selected channel applied. When the channel differs from the one
+ * selected before, the first conversion is thrown away as the gain stage
+ * needs time to settle after switching.
+ * The 10x and 200x gain channels need the ADC clock to be at most 200 kHz,
+ * see the datasheet for the accuracy of these channels.
+ * @param channel The differential channel with the gain to use
+ * @return int16_t the signed result (-512 to 511)
+ */
+int16_t ReadAdcDifferential(ADC_DIFF_CHANNEL channel);
+
+/** @brief  Convert the raw result of a differential conversion to a signed value
+ *
+ * Useful for results coming from the scan engine or the stream, which hand
+ * out the raw ADC register. Follows the ADLAR setting made in AdcInit()
+ * @param adc_value The raw value as read from the ADC register
+ * @return int16_t the signed result (-512 to 511)
+ */
+int16_t AdcDifferentialValue(uint16_t adc_value);
+
+#if USE_ADC_IN_INTERRUPT_MODE
+/** @brief Set up the list of channels walked by the scan engine
+ *
+ * The list is copied, so the caller does not need to keep it around. At most
+ * MAX_NO_OF_SCAN_CHANNELS entries are taken, the rest are ignored. Must not be
+ * called while a scan is running.
+ * @param channels The channel numbers (0-7) or ADC_DIFF_CHANNEL values in the
+ *                 order they are converted
+ * @param no_of_channels Number of entries in channels
+ */
+void AdcScanInit(const uint8_t *channels, uint8_t no_of_channels);
+
+/** @brief Start walking the channel list from the ADC conversion complete ISR
+ *
+ * Every conversion result is stored in the back half of a double buffered
+ * sample table. When the last channel of the list is converted the two halves
+ * are swapped, which publishes the whole scan at once.
+ * ReadAdc() must not be used while a scan is running.
+ * @param continuous true to restart from the first channel after every scan,
+ *                   false to stop after a single scan
+ */
+void AdcScanStart(bool continuous);
+
+/** @brief Stop the scan engine
+ *
+ * A conversion that is already in progress is discarded. The last published
+ * scan stays available through AdcScanGetSnapshot()
+ */
+void AdcScanStop();
+
+/** @brief Check if the scan engine is still running
+ * @return true while a scan is in progress
+ */
+bool AdcScanIsBusy();
+
+/** @brief Copy the last published scan without blocking
+ *
+ * The copy is always taken from one complete scan, a scan published while
+ * copying causes the copy to be taken again.
+ * @param samples Buffer of at least no_of_channels entries, one per channel in
+ *                the order of the channel list
+ * @return true if a new scan was published since the previous call
+ */
+bool AdcScanGetSnapshot(uint16_t *samples);
+
+/** @brief Start fixed rate sampling of one channel using the auto trigger
+ *
+ * Conversions are started by the hardware on every event of the trigger
+ * source, so the sample rate is set by the timer alone and does not depend on
+ * the main loop. Setting up the timer (e.g. Timer1 in CTC mode with OCR1A
+ * giving the sample period and OCR1B = 0, with
+ * TRIGGER_TIMER_1_COMPARE_MATCH_B) is left to the caller. For the timer
+ * sources the interrupt flag that fires the trigger is cleared by the ADC
+ * ISR, so the timer interrupt itself does not need to be enabled.
+ * With TIMER_SYSTEM_CLOCK (timerconfig.h) Timer0 runs the system clock: do
+ * not reprogram it and do not use the Timer0 triggers, clearing OCF0 would
+ * lose the millisecond tick.
+ * The ISR pushes every sample into a ring buffer of ADC_STREAM_BUFFER_SIZE
+ * entries which is drained with AdcStreamRead(). There is a single producer
+ * (the ISR) and a single consumer (the main loop) so no locking is needed.
+ * @param channel The channel number of the ADC to sample (0-7) or an
+ *                ADC_DIFF_CHANNEL value
+ * @param trigger The event that starts each conversion
+ */
+void AdcStreamStart(uint8_t channel, ADC_TRIGGER_SOURCE trigger);
+
+/** @brief Stop the auto triggered sampling
+ *
+ * Samples already in the ring buffer can still be read
+ */
+void AdcStreamStop();
+
+/** @brief Number of samples waiting in the ring buffer
+ * @return number of samples that can be read without waiting
+ */
+uint8_t AdcStreamAvailable();
 
+/** @brief Move up to max_samples samples out of the ring buffer
+ * @param samples Buffer the samples are copied to, oldest sample first
+ * @param max_samples Size of samples
+ * @return number of samples copied, 0 if the ring buffer is empty
+ */
+uint8_t AdcStreamRead(uint16_t *samples, uint8_t max_samples);
+
+/** @brief Number of samples lost because the ring buffer was full
+ *
+ * The counter saturates at 0xFFFF and is cleared by AdcStreamStart()
+ * @return number of dropped samples
+ */
+uint16_t AdcStreamOverruns();
+
+/** @brief Start an oversampled reading of one channel
+ *
+ * The ADC ISR takes 4^extra_bits conversions back to back, adds them up in a
+ * 32 bit accumulator and shifts the sum right by extra_bits. The result has
+ * 10 + extra_bits bits of resolution (e.g. 3 extra bits, 64 conversions, 13
+ * bit result). This only gains resolution if there is at least 1 LSB of noise
+ * on the input. The result is always right adjusted, whatever ADLAR is set to.
+ * @param channel The channel number of the ADC to read from (0-7)
+ * @param extra_bits Bits of resolution to add (1 - ADC_OVERSAMPLE_MAX_EXTRA_BITS)
+ * @return false if extra_bits is out of range or the engine is busy
+ */
+bool AdcOversampleStart(uint8_t channel, uint8_t extra_bits);
+
+/** @brief Check if an oversampled reading is still in progress
+ * @return true until the result of AdcOversampleStart() is available
+ */
+bool AdcOversampleIsBusy();
 
-/* this is a comemnt which his a kajslkdj  lkasdlaksh  lisahlahd ;
- * kash lhaks lkashd llkahd ald lksh  lasjlakskjds d ljkasjd asdj lkj
- * jksdjaksldja djk jaslkdj 
+/** @brief Result of the last oversampled reading
+ * @return the decimated value with 10 + extra_bits bits
+ */
+uint16_t AdcOversampleResult();
+
+/** @brief Oversampled reading in a single call
+ *
+ * Same as AdcOversampleStart() followed by waiting for the result
+ * @param channel The channel number of the ADC to read from (0-7)
+ * @param extra_bits Bits of resolution to add (1 - ADC_OVERSAMPLE_MAX_EXTRA_BITS)
+ * @return the decimated value, 0 if the reading could not be started
+ */
+uint16_t ReadAdcOversampled(uint8_t channel, uint8_t extra_bits);
+
+/** @brief Read a channel with the CPU in ADC Noise Reduction sleep mode
+ *
+ * Entering SLEEP_MODE_ADC starts the conversion and the ADC interrupt wakes
+ * the CPU again, so no digital noise from the core gets into the sample and
+ * the CPU draws no active current while waiting. Other interrupts also wake
+ * the CPU, in which case it goes back to sleep until the conversion is done.
+ * Note that the I/O clock is stopped in this sleep mode, Timer0/Timer1 and
+ * the USART do not run while sleeping. Global interrupts are enabled by this
+ * function as they are needed to wake up.
+ * @param channel The channel number of the ADC to read from (0-7)
+ * @return the right or left adjusted value as set by AdcInit()
+ */
+uint16_t ReadAdcSleep(uint8_t channel);
+
+/** @brief Do one scan of the channel list in ADC Noise Reduction sleep mode
+ *
+ * Same as AdcScanStart(false) but the CPU sleeps during every conversion
+ * and the function only returns when the scan is published. The result is
+ * read with AdcScanGetSnapshot(). See ReadAdcSleep() for the side effects of
+ * the sleep mode.
+ */
+void AdcScanSleep();
+
+/** @brief Start a conversion and return right away
+ *
+ * The result is delivered by the ADC ISR, either to the callback or for
+ * picking up with AdcPoll(). The channel is only written to ADMUX when it
+ * differs from the last one used, so repeated reads of one channel cost a
+ * single register write (ADSC). If the channel or the reference changed, the
+ * first conversion is thrown away and a second one is done.
+ * @param channel The channel number of the ADC (0-7) or an ADC_DIFF_CHANNEL value
+ * @param callback Called from the ADC ISR with the result, NULL to poll. Keep it
+ *                 short, it runs with interrupts disabled. It may start the
+ *                 next conversion with AdcStartAsync()
+ * @return false if a conversion or another engine mode is still running
+ */
+bool AdcStartAsync(uint8_t channel, ADC_CALLBACK callback);
+
+/** @brief Pick up the result of the last AdcStartAsync() without waiting
+ * @param value Set to the raw ADC register value if a result is ready
+ * @return true if a result was ready, it is handed out only once
+ */
+bool AdcPoll(uint16_t *value);
+#endif
+
+#endif
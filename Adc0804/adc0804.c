@@ -90,7 +90,7 @@ void ReadAdc0804Value()
 void DisplayAdcValueOnLCD()
 {
     LcdSendCommand(ClearDisplay);
-    LcdSendString("ADC Value :");
+    LcdSendStringF("ADC Value :");
     LcdSendInteger((uint16_t)g_adc_value);
 }	
  
@@ -0,0 +1,266 @@
+/*
+ * File : console.c
+ *
+ * Description:
+ * File contains the command console on the USART receive path. Lines are
+ * put together in the receive interrupt and run from the main loop.
+ *
+ * Note:
+ * For detail documentation about the use of the console refer the header
+ * file console.h
+ * Refer to E:/Avrprojects/library/coding standards.doc for coding standards
+ *
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "usart.h"
+#include "console.h"
+
+#define CONSOLE_BACKSPACE 0x08
+#define CONSOLE_DELETE 0x7F
+
+/* Command table in flash */
+static const CONSOLE_COMMAND *console_commands;
+static uint8_t console_command_count;
+
+/* Two line buffers, the ISR fills console_lines[console_fill] while the
+ * other one may be waiting for or being run by ConsoleService() */
+static char console_lines[2][CONSOLE_LINE_SIZE];
+static volatile uint8_t console_fill;
+static volatile bool console_ready;
+static volatile uint16_t console_dropped;
+
+/* Line assembler state, only used from the ISR once ConsoleInit() is done */
+static uint8_t console_length;
+static bool console_overflow;
+
+/*
+ * Function: console_rx_byte()
+ *
+ * Description: Line assembler fed from the USART Receive Complete
+ * interrupt. A finished line is handed over by switching buffers, an empty
+ * line (e.g. the '\n' of a "\r\n") is ignored.
+ *
+ * Returns: Nothing
+ */
+static void console_rx_byte(uint8_t data)
+{
+    if ((data == '\r') || (data == '\n'))
+    {
+        if (console_overflow)
+        {
+            console_overflow = false;
+            console_dropped++;
+        }
+        else if (console_length)
+        {
+            if (console_ready)
+            {
+                console_dropped++;
+            }
+            else
+            {
+                console_lines[console_fill][console_length] = '\0';
+                console_fill ^= 1;
+                console_ready = true;
+            }
+        }
+        console_length = 0;
+    }
+    else if ((data == CONSOLE_BACKSPACE) || (data == CONSOLE_DELETE))
+    {
+        if (console_length)
+        {
+            console_length--;
+        }
+    }
+    else if (console_overflow)
+    {
+        /* Skip up to the end of the line */
+    }
+    else if (console_length >= CONSOLE_LINE_SIZE - 1)
+    {
+        console_overflow = true;
+    }
+    else
+    {
+        console_lines[console_fill][console_length++] = (char)data;
+    }
+}
+
+/*
+ * Function: console_split()
+ *
+ * Description: Splits the line into words in place, the blanks after each
+ * word are overwritten with '\0'
+ *
+ * Returns: Number of words, CONSOLE_MAX_ARGS + 1 if there are too many
+ */
+static uint8_t console_split(char *line, char **argv)
+{
+    uint8_t argc = 0;
+
+    for (;;)
+    {
+        while ((*line == ' ') || (*line == '\t'))
+        {
+            line++;
+        }
+        if (*line == '\0')
+        {
+            return argc;
+        }
+        if (argc == CONSOLE_MAX_ARGS)
+        {
+            return CONSOLE_MAX_ARGS + 1;
+        }
+        argv[argc++] = line;
+        while ((*line != ' ') && (*line != '\t') && (*line != '\0'))
+        {
+            line++;
+        }
+        if (*line != '\0')
+        {
+            *line++ = '\0';
+        }
+    }
+}
+
+/*
+ * Function: console_find()
+ *
+ * Description: Binary search for the command name in the sorted table in
+ * flash, comparing with strcmp_P() so the names are never copied
+ *
+ * Returns: The handler, NULL if there is no such command
+ */
+static CONSOLE_HANDLER console_find(const char *name)
+{
+    uint8_t low = 0;
+    uint8_t high = console_command_count;
+    uint8_t middle;
+    int compare;
+
+    while (low < high)
+    {
+        middle = (uint8_t)((low + high) >> 1);
+        compare = strcmp_P(name, console_commands[middle].name);
+        if (compare == 0)
+        {
+            return (CONSOLE_HANDLER)pgm_read_ptr(&console_commands[middle].handler);
+        }
+        if (compare < 0)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle + 1;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Function: ConsoleInit()
+ *
+ * Description: Checks the command table is sorted and routes the received
+ * bytes to the line assembler. For more details see console.h
+ *
+ * Returns: false if the table is not sorted
+ */
+bool ConsoleInit(const CONSOLE_COMMAND *commands, uint8_t count)
+{
+    char name[CONSOLE_NAME_SIZE];
+    uint8_t i;
+
+    for (i = 1; i < count; i++)
+    {
+        memcpy_P(name, commands[i - 1].name, CONSOLE_NAME_SIZE);
+        if (strcmp_P(name, commands[i].name) >= 0)
+        {
+            return false;
+        }
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        console_commands = commands;
+        console_command_count = count;
+        console_fill = 0;
+        console_ready = false;
+        console_dropped = 0;
+        console_length = 0;
+        console_overflow = false;
+        UsartSetRxHandler(console_rx_byte);
+    }
+    return true;
+}
+
+void ConsoleStop()
+{
+    UsartSetRxHandler(NULL);
+}
+
+/*
+ * Function: ConsoleService()
+ *
+ * Description: Runs the command of the line waiting, if any. For more
+ * details see console.h
+ *
+ * Returns: What was done
+ */
+CONSOLE_STATUS ConsoleService()
+{
+    char *argv[CONSOLE_MAX_ARGS];
+    CONSOLE_HANDLER handler;
+    CONSOLE_STATUS status;
+    uint8_t argc;
+
+    if (!console_ready)
+    {
+        return CONSOLE_IDLE;
+    }
+
+    /* The ISR has moved on to the other buffer and leaves this one alone
+     * until console_ready is cleared */
+    argc = console_split(console_lines[console_fill ^ 1], argv);
+    if (argc == 0)
+    {
+        status = CONSOLE_EMPTY_LINE;
+    }
+    else if (argc > CONSOLE_MAX_ARGS)
+    {
+        UsartSendStringF("?too many arguments\r\n");
+        status = CONSOLE_TOO_MANY_ARGS;
+    }
+    else if ((handler = console_find(argv[0])) == NULL)
+    {
+        UsartPrintf("?%s\r\n", argv[0]);
+        status = CONSOLE_UNKNOWN;
+    }
+    else
+    {
+        handler(argc, argv);
+        status = CONSOLE_DONE;
+    }
+
+    console_ready = false;
+    return status;
+}
+
+uint16_t ConsoleDroppedLines()
+{
+    uint16_t dropped;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        dropped = console_dropped;
+    }
+    return dropped;
+}
@@ -0,0 +1,102 @@
+/************************************************************************
+ * Name : console.h
+ *
+ * Header file for the console.c file
+ *
+ * Contains the macros, types and function definitions for a command console
+ * on the USART. Lines are put together in the receive interrupt, the main
+ * loop only calls ConsoleService() which never waits for input.
+ ************************************************************************/
+/************
+Usage
+
+	static void CmdAdc(uint8_t argc, char **argv) { ... }
+	static void CmdLed(uint8_t argc, char **argv) { ... }
+
+	// Sorted by name (strcmp order), names at most CONSOLE_NAME_SIZE - 1 long
+	static const CONSOLE_COMMAND commands[] PROGMEM =
+	{
+		{ "adc", CmdAdc },
+		{ "led", CmdLed },
+	};
+
+	UsartInit(...);
+	ConsoleInit(commands, sizeof(commands) / sizeof(commands[0]));
+	sei();
+	for (;;)
+	{
+		ConsoleService();
+		... motor and sensor handling ...
+	}
+
+	"led 1 on" calls CmdLed with argc 3 and argv "led", "1", "on". The
+	characters are not echoed, turn on local echo in the terminal program.
+*************/
+
+#ifndef _CONSOLE_H_
+#define _CONSOLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+
+/* Longest line taken including the '\0', longer lines are dropped */
+#define CONSOLE_LINE_SIZE 48
+/* Most words per line including the command name */
+#define CONSOLE_MAX_ARGS 8
+/* Room for a command name including the '\0' */
+#define CONSOLE_NAME_SIZE 10
+
+/* Command handler, argv[0] is the command name. The strings live in the
+ * line buffer and are only valid until the handler returns */
+typedef void (*CONSOLE_HANDLER)(uint8_t argc, char **argv);
+
+/* Entry of the command table, the table has to be in flash (PROGMEM) */
+typedef struct
+{
+    char name[CONSOLE_NAME_SIZE];
+    CONSOLE_HANDLER handler;
+}CONSOLE_COMMAND;
+
+typedef enum CONSOLE_STATUS
+{
+    CONSOLE_IDLE,           /* No line waiting */
+    CONSOLE_DONE,           /* A command ran */
+    CONSOLE_EMPTY_LINE,     /* Line with nothing but blanks */
+    CONSOLE_UNKNOWN,        /* No command with that name */
+    CONSOLE_TOO_MANY_ARGS   /* More than CONSOLE_MAX_ARGS words */
+}CONSOLE_STATUS;
+
+/** @brief Set the command table and take over the USART receiver
+ *
+ * The USART has to be set up with UsartInit() before. From here on every
+ * received byte goes to the line assembler in the receive interrupt,
+ * UsartRead()/UsartReceive() get no data. Lines end with '\r' or '\n',
+ * backspace and delete remove the last character.
+ * @param commands Command table in flash, sorted by name
+ * @param count Number of entries in the table
+ * @return false if the table is not sorted (binary search would miss)
+ */
+bool ConsoleInit(const CONSOLE_COMMAND *commands, uint8_t count);
+
+/** @brief Stop the console, the received bytes go to the USART receive ring
+ * buffer again
+ */
+void ConsoleStop();
+
+/** @brief Run the command of a finished line, if there is one
+ *
+ * Never waits for input, to be called from the main loop. The line is split
+ * into words in place, the name is looked up with a binary search in the
+ * table and the handler called. An unknown command is answered with
+ * "?name". While the handler runs the next line is already being received.
+ * @return what was done, CONSOLE_IDLE if no line was waiting
+ */
+CONSOLE_STATUS ConsoleService();
+
+/** @brief Number of lines lost, too long or arriving while the previous
+ * line was not yet serviced
+ */
+uint16_t ConsoleDroppedLines();
+
+#endif
@@ -12,6 +12,8 @@
 
 #include <util/delay.h>
 #include <stdbool.h> 
+#include <stdarg.h>
+#include <avr/pgmspace.h>
 
 /* extra include files
  * NOTE: for files not in the same directory .. it is important to give the relative path
@@ -23,12 +25,14 @@
 /* for use in AS5 */
 /* #include "lcdpinconfig.h"
    #include "lcd16x2.h"
-   #include "portconfig.h"*/
+   #include "portconfig.h"
+   #include "format.h"*/
 
 /* for use in AS4*/
 #include "../../Library/PortConfig/portconfig.h"
 #include "lcdpinconfig.h"
 #include "lcd16x2.h"
+#include "../../Library/Utils/format.h"
 
 /*TODO character generation*/
 /*#include "characters.h"*/
@@ -98,6 +102,47 @@ void LcdSendString(char *str)
 	    }  
 }
 
+/*
+ * Function: LcdSendString_P()
+ * 
+ * Description: Sends a string stored in flash to the LCD, read byte by byte
+ * without a copy in SRAM
+ *
+ * Returns: Nothing 
+ */
+void LcdSendString_P(const char *str)
+{
+    char c;
+
+    while ((c = pgm_read_byte(str)) != '\0')
+    {
+        LcdSendByte((uint8_t)c, true);
+        str++;
+    }
+}
+
+/* Character sink for FormatPrint_P() */
+static void lcd_put(char c)
+{
+    LcdSendByte((uint8_t)c, true);
+}
+
+/*
+ * Function: LcdPrintf_P()
+ * 
+ * Description: Displays the formatted output of a format string in flash
+ *
+ * Returns: Nothing 
+ */
+void LcdPrintf_P(const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    FormatPrint_P(lcd_put, format, args);
+    va_end(args);
+}
+
 /*
  * Function: LcdSendByte()
  * 
@@ -144,7 +189,7 @@ void LcdGoToXY(uint8_t x, uint8_t y)
 	uint8_t address; 
     if (y > 1 || x > 16) // y = 0 (line 1) y =1 (line 2 ) , x = (0-15) coulmn number  
     {
-		LcdSendString("Check X,Y coordinate");        
+		LcdSendStringF("Check X,Y coordinate");        
 	}
 	else
 	{
@@ -168,40 +213,60 @@ void LcdGoToXY(uint8_t x, uint8_t y)
 /*
  * Function: LcdSendInteger()
  * 
- * Description: Dispalys the Integer value passed in on the Lcd module 
+ * Description: Dispalys the Integer value passed in on the Lcd module,
+ * without leading zeros
  *
  * Returns: Nothing 
  */
 void LcdSendInteger(int16_t val)
 {
-    /* The variable number stores the remainder of the integer value being passed
-	 */
-	uint8_t number[5]= {0,0,0,0,0}; 
-    int8_t i;
-    bool is_val_neg = false;
-    if(val < 0)
-    {
-       LcdSendData('-');
-	   is_val_neg = true; 
-    }
-     
-	for(i= 0;i<=4;i++)
-    {
-        number[i] = val % 10;
-        val= val / 10;
-    }
-    /* Display the stored numbers in reverse order, as they are stored inreverse order
-     * in the upper for loop 
-     */        
-	for(i= 4; i>= 0; i--)
-	{
-        if(is_val_neg)
-        {
-            LcdSendData((48 + (number[i] * -1)));						
-        }
-        else
-        {
-            LcdSendData(48 + number[i]);			
-        }
-	}
+    LcdSendNumber(val, 0, ' ');
+}
+
+/*
+ * Function: LcdSendNumber()
+ *
+ * Description: Displays the number passed in in decimal, padded up to
+ * width with pad
+ *
+ * Returns: Nothing
+ */
+void LcdSendNumber(int32_t val, uint8_t width, char pad)
+{
+    char buffer[FORMAT_BUFFER_SIZE];
+
+    FormatSigned(buffer, val, width, pad);
+    LcdSendString(buffer);
+}
+
+/*
+ * Function: LcdSendHex()
+ *
+ * Description: Displays the number passed in in hex with at least digits
+ * digits
+ *
+ * Returns: Nothing
+ */
+void LcdSendHex(uint32_t val, uint8_t digits)
+{
+    char buffer[FORMAT_BUFFER_SIZE];
+
+    FormatHex(buffer, val, digits);
+    LcdSendString(buffer);
+}
+
+/*
+ * Function: LcdSendFixed()
+ *
+ * Description: Displays the fixed point number passed in, val is the number
+ * times 10^decimals
+ *
+ * Returns: Nothing
+ */
+void LcdSendFixed(int32_t val, uint8_t decimals, uint8_t width)
+{
+    char buffer[FORMAT_BUFFER_SIZE];
+
+    FormatFixed(buffer, val, decimals, width, ' ');
+    LcdSendString(buffer);
 }
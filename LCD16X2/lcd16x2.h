@@ -22,6 +22,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 
 /*add the pin configuration file*/
 #include "lcdpinconfig.h"
@@ -141,11 +142,52 @@ void LcdGoToXY(uint8_t, uint8_t);
 void LcdSendString(char *);
 
 /************************************************************************
- * Function sends a integer of type uint16 (max value 65535) to be displayed on the LCD 
- *  
- * TODO: write the description here  
+ * Function sends a string stored in flash to be displayed on the LCD
+ * 
+ * The string is read with pgm_read_byte() and never copied to SRAM,
+ * LcdSendStringF("...") does the same for a literal
+ ************************************************************************/
+void LcdSendString_P(const char *);
+#define LcdSendStringF(str) LcdSendString_P(PSTR(str))
+
+/************************************************************************
+ * Function displays formatted output with the format string in flash
+ * 
+ * See FormatPrint_P() in format.h for the supported conversions,
+ * LcdPrintf("...", ...) keeps a literal format string in flash
+ ************************************************************************/
+void LcdPrintf_P(const char *format, ...);
+#define LcdPrintf(format, ...) LcdPrintf_P(PSTR(format), ##__VA_ARGS__)
+
+/************************************************************************
+ * Function sends a integer of type int16 (-32768 to 32767) to be displayed on the LCD 
+ * 
+ * The number is displayed without leading zeros  
+ ************************************************************************/
+void LcdSendInteger(int16_t);
+
+/************************************************************************
+ * Function sends a number to be displayed on the LCD in decimal
+ * 
+ * The number is padded up to width characters with pad ('0' or ' '),
+ * a width of 0 means no padding
+ ************************************************************************/
+void LcdSendNumber(int32_t val, uint8_t width, char pad);
+
+/************************************************************************
+ * Function sends a number to be displayed on the LCD in upper case hex
+ * 
+ * At least digits digits are displayed, filled up with '0'
+ ************************************************************************/
+void LcdSendHex(uint32_t val, uint8_t digits);
+
+/************************************************************************
+ * Function sends a fixed point number to be displayed on the LCD
+ * 
+ * val is the number times 10^decimals, e.g. 2515 with 2 decimals shows
+ * 25.15, the result is padded with spaces up to width characters
  ************************************************************************/
-void LcdSendInteger(uint16_t);
+void LcdSendFixed(int32_t val, uint8_t decimals, uint8_t width);
 
 #endif /*end of #ifndef _LCD_16X2_H_*/  
 
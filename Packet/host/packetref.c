@@ -0,0 +1,372 @@
+/*
+ * File : packetref.c
+ *
+ * Description:
+ * Host side reference encoder/decoder for the frame format of packet.c,
+ * for testing the packet layer from a PC over a serial port, a pty or a
+ * loopback stand-in. Plain C with POSIX I/O, it is not part of the AVR
+ * library build.
+ *
+ *   gcc -Wall -o packetref packetref.c
+ *
+ *   packetref selftest                     encode/decode check, no device
+ *   packetref send <device> <type> [byte]  send one frame, bytes in hex
+ *   packetref receive <device>             print every frame received
+ *
+ * A pty pair to play with can be made with
+ *   socat -d -d pty,raw,echo=0 pty,raw,echo=0
+ * the baud rate of a real port is set beforehand with stty.
+ *
+ * Note:
+ * For detail documentation about the frame format refer the header file
+ * ../packet.h
+ * Refer to E:/Avrprojects/library/coding standards.doc for coding standards
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+
+#define PACKETREF_MAX_PAYLOAD 64
+#define PACKETREF_OVERHEAD 4
+#define PACKETREF_MAX_FRAME (PACKETREF_MAX_PAYLOAD + PACKETREF_OVERHEAD)
+/* COBS adds one byte per 254 plus the delimiter */
+#define PACKETREF_MAX_ENCODED (PACKETREF_MAX_FRAME + PACKETREF_MAX_FRAME / 254 + 2)
+
+#define PACKETREF_OK 0
+#define PACKETREF_FRAMING_ERROR -1
+#define PACKETREF_CRC_ERROR -2
+
+/*
+ * Function: PacketRefCrc16()
+ *
+ * Description: CRC-16/CCITT-FALSE, bit by bit so it is easy to check
+ * against the byte wise version in packet.c
+ *
+ * Returns: The new CRC
+ */
+uint16_t PacketRefCrc16(uint16_t crc, uint8_t data)
+{
+    int bit;
+
+    crc ^= (uint16_t)data << 8;
+    for (bit = 0; bit < 8; bit++)
+    {
+        crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+/*
+ * Function: PacketRefEncode()
+ *
+ * Description: Builds a frame, COBS encodes it and adds the delimiter.
+ * out needs PACKETREF_MAX_ENCODED bytes
+ *
+ * Returns: Number of bytes in out, 0 if the payload is too long
+ */
+size_t PacketRefEncode(uint8_t sequence, uint8_t type, const uint8_t *payload,
+                       size_t length, uint8_t *out)
+{
+    uint8_t frame[PACKETREF_MAX_FRAME];
+    size_t frame_length = length + PACKETREF_OVERHEAD;
+    uint16_t crc = 0xFFFF;
+    size_t code_at = 0;
+    size_t out_length = 1;
+    size_t i;
+
+    if (length > PACKETREF_MAX_PAYLOAD)
+    {
+        return 0;
+    }
+
+    frame[0] = sequence;
+    frame[1] = type;
+    memcpy(&frame[2], payload, length);
+    for (i = 0; i < length + 2; i++)
+    {
+        crc = PacketRefCrc16(crc, frame[i]);
+    }
+    frame[length + 2] = (uint8_t)(crc >> 8);
+    frame[length + 3] = (uint8_t)crc;
+
+    for (i = 0; i < frame_length; i++)
+    {
+        if (frame[i] == 0)
+        {
+            out[code_at] = (uint8_t)(out_length - code_at);
+            code_at = out_length++;
+        }
+        else
+        {
+            out[out_length++] = frame[i];
+            if (out_length - code_at == 0xFF)
+            {
+                out[code_at] = 0xFF;
+                code_at = out_length++;
+            }
+        }
+    }
+    out[code_at] = (uint8_t)(out_length - code_at);
+    out[out_length++] = 0x00;
+
+    return out_length;
+}
+
+/*
+ * Function: PacketRefDecode()
+ *
+ * Description: Decodes one COBS encoded frame (without the delimiter) and
+ * checks the CRC. payload needs PACKETREF_MAX_PAYLOAD bytes
+ *
+ * Returns: PACKETREF_OK, PACKETREF_FRAMING_ERROR or PACKETREF_CRC_ERROR
+ */
+int PacketRefDecode(const uint8_t *in, size_t in_length, uint8_t *sequence,
+                    uint8_t *type, uint8_t *payload, size_t *length)
+{
+    uint8_t frame[PACKETREF_MAX_FRAME];
+    size_t frame_length = 0;
+    uint16_t crc = 0xFFFF;
+    size_t i = 0;
+    uint8_t code;
+    uint8_t n;
+
+    while (i < in_length)
+    {
+        code = in[i++];
+        if (code == 0)
+        {
+            return PACKETREF_FRAMING_ERROR;
+        }
+        for (n = 1; n < code; n++)
+        {
+            if ((i >= in_length) || (in[i] == 0) || (frame_length >= PACKETREF_MAX_FRAME))
+            {
+                return PACKETREF_FRAMING_ERROR;
+            }
+            frame[frame_length++] = in[i++];
+        }
+        if ((code != 0xFF) && (i < in_length))
+        {
+            if (frame_length >= PACKETREF_MAX_FRAME)
+            {
+                return PACKETREF_FRAMING_ERROR;
+            }
+            frame[frame_length++] = 0;
+        }
+    }
+
+    if (frame_length < PACKETREF_OVERHEAD)
+    {
+        return PACKETREF_FRAMING_ERROR;
+    }
+    for (i = 0; i < frame_length; i++)
+    {
+        crc = PacketRefCrc16(crc, frame[i]);
+    }
+    if (crc != 0)
+    {
+        return PACKETREF_CRC_ERROR;
+    }
+
+    *sequence = frame[0];
+    *type = frame[1];
+    *length = frame_length - PACKETREF_OVERHEAD;
+    memcpy(payload, &frame[2], *length);
+    return PACKETREF_OK;
+}
+
+/*
+ * Function: packetref_selftest()
+ *
+ * Description: Round trips frames of every length with and without zeros
+ * and checks that a flipped bit is caught
+ *
+ * Returns: Number of failures
+ */
+static int packetref_selftest(void)
+{
+    uint8_t payload[PACKETREF_MAX_PAYLOAD];
+    uint8_t decoded[PACKETREF_MAX_PAYLOAD];
+    uint8_t encoded[PACKETREF_MAX_ENCODED];
+    uint8_t sequence;
+    uint8_t type;
+    size_t length;
+    size_t encoded_length;
+    size_t i;
+    int failures = 0;
+    int pass;
+
+    for (pass = 0; pass < 1000; pass++)
+    {
+        length = (size_t)rand() % (PACKETREF_MAX_PAYLOAD + 1);
+        for (i = 0; i < length; i++)
+        {
+            /* Plenty of zeros to exercise the stuffing */
+            payload[i] = (rand() & 3) ? 0 : (uint8_t)rand();
+        }
+        encoded_length = PacketRefEncode((uint8_t)pass, (uint8_t)(pass >> 3),
+                                         payload, length, encoded);
+        if (memchr(encoded, 0, encoded_length - 1) != NULL)
+        {
+            failures++;
+            continue;
+        }
+        if ((PacketRefDecode(encoded, encoded_length - 1, &sequence, &type,
+                             decoded, &i) != PACKETREF_OK)
+            || (sequence != (uint8_t)pass) || (type != (uint8_t)(pass >> 3))
+            || (i != length) || memcmp(payload, decoded, length))
+        {
+            failures++;
+            continue;
+        }
+        /* A single flipped bit has to be caught */
+        encoded[1 + (size_t)rand() % (encoded_length - 2)] ^= (uint8_t)(1 << (rand() & 7));
+        if (PacketRefDecode(encoded, encoded_length - 1, &sequence, &type,
+                            decoded, &i) == PACKETREF_OK)
+        {
+            failures++;
+        }
+    }
+    printf("selftest: %d failures\n", failures);
+    return failures;
+}
+
+/*
+ * Function: packetref_open()
+ *
+ * Description: Opens the device and sets a terminal to raw mode
+ *
+ * Returns: File descriptor, -1 on error
+ */
+static int packetref_open(const char *device)
+{
+    struct termios tio;
+    int fd = open(device, O_RDWR | O_NOCTTY);
+
+    if (fd < 0)
+    {
+        perror(device);
+        return -1;
+    }
+    if (isatty(fd) && (tcgetattr(fd, &tio) == 0))
+    {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+/*
+ * Function: packetref_receive()
+ *
+ * Description: Splits the byte stream at the delimiters and prints every
+ * frame with its result
+ *
+ * Returns: Only on a read error
+ */
+static int packetref_receive(int fd)
+{
+    uint8_t encoded[PACKETREF_MAX_ENCODED];
+    uint8_t payload[PACKETREF_MAX_PAYLOAD];
+    size_t encoded_length = 0;
+    uint8_t sequence;
+    uint8_t type;
+    size_t length;
+    size_t i;
+    uint8_t data;
+    int result;
+
+    while (read(fd, &data, 1) == 1)
+    {
+        if (data != 0)
+        {
+            if (encoded_length < sizeof(encoded))
+            {
+                encoded[encoded_length] = data;
+            }
+            encoded_length++;
+            continue;
+        }
+        if (encoded_length == 0)
+        {
+            continue;
+        }
+        if (encoded_length > sizeof(encoded))
+        {
+            result = PACKETREF_FRAMING_ERROR;
+        }
+        else
+        {
+            result = PacketRefDecode(encoded, encoded_length, &sequence, &type,
+                                     payload, &length);
+        }
+        encoded_length = 0;
+
+        if (result == PACKETREF_CRC_ERROR)
+        {
+            printf("CRC error\n");
+        }
+        else if (result != PACKETREF_OK)
+        {
+            printf("framing error\n");
+        }
+        else
+        {
+            printf("seq %3u type %02X len %2u :", sequence, type, (unsigned)length);
+            for (i = 0; i < length; i++)
+            {
+                printf(" %02X", payload[i]);
+            }
+            printf("\n");
+        }
+        fflush(stdout);
+    }
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t payload[PACKETREF_MAX_PAYLOAD];
+    uint8_t encoded[PACKETREF_MAX_ENCODED];
+    size_t encoded_length;
+    int length;
+    int fd;
+
+    if ((argc == 2) && !strcmp(argv[1], "selftest"))
+    {
+        return packetref_selftest() ? 1 : 0;
+    }
+    if ((argc == 3) && !strcmp(argv[1], "receive"))
+    {
+        fd = packetref_open(argv[2]);
+        return (fd < 0) ? 1 : packetref_receive(fd);
+    }
+    if ((argc >= 4) && !strcmp(argv[1], "send")
+        && (argc - 4 <= PACKETREF_MAX_PAYLOAD))
+    {
+        for (length = 0; length < argc - 4; length++)
+        {
+            payload[length] = (uint8_t)strtoul(argv[4 + length], NULL, 16);
+        }
+        /* Every run starts at sequence 0, like the AVR after PacketInit() */
+        encoded_length = PacketRefEncode(0, (uint8_t)strtoul(argv[3], NULL, 16),
+                                         payload, (size_t)length, encoded);
+        fd = packetref_open(argv[2]);
+        if ((fd < 0) || (write(fd, encoded, encoded_length) != (ssize_t)encoded_length))
+        {
+            return 1;
+        }
+        close(fd);
+        return 0;
+    }
+
+    fprintf(stderr, "usage: %s selftest | send <device> <type> [byte...] | receive <device>\n",
+            argv[0]);
+    return 2;
+}
@@ -0,0 +1,346 @@
+/*
+ * File : packet.c
+ *
+ * Description:
+ * File contains the COBS framed, CRC checked packet layer on top of the
+ * interrupt driven USART driver
+ *
+ * Note:
+ * For detail documentation about the frame format and the functions refer
+ * the header file packet.h
+ * Refer to E:/Avrprojects/library/coding standards.doc for coding standards
+ *
+ */
+
+#include <avr/io.h>
+#include <util/atomic.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "usart.h"
+#include "packet.h"
+
+/* Frame being sent, only used from the main loop */
+static uint8_t packet_tx_frame[PACKET_MAX_FRAME];
+static uint8_t packet_tx_sequence;
+
+/* Two receive buffers, the ISR decodes into packet_rx_frames[packet_rx_fill]
+ * while the other one may be held by the application */
+static uint8_t packet_rx_frames[2][PACKET_MAX_FRAME];
+static volatile uint8_t packet_rx_fill;
+static volatile bool packet_rx_ready;
+static volatile uint8_t packet_rx_ready_length;
+
+/* Decoder state, only used from the ISR once PacketInit() is done */
+static uint8_t packet_rx_length;    /* Bytes decoded so far */
+static uint8_t packet_rx_code;      /* Bytes left in the current COBS block */
+static bool packet_rx_zero;         /* A 0x00 follows the current block */
+static bool packet_rx_discard;      /* Skip up to the next delimiter */
+static uint16_t packet_rx_crc;
+static bool packet_rx_synced;       /* packet_rx_sequence is valid */
+static uint8_t packet_rx_sequence;  /* Sequence number expected next */
+
+static volatile PACKET_STATS packet_stats;
+
+/*
+ * Function: PacketCrc16()
+ *
+ * Description: Updates the CRC-16/CCITT-FALSE with one byte. Works on the
+ * whole byte with shifts and xors instead of a bit loop or a table. For
+ * more details see packet.h
+ *
+ * Returns: The new CRC
+ */
+uint16_t PacketCrc16(uint16_t crc, uint8_t data)
+{
+    crc = (crc >> 8) | (crc << 8);
+    crc ^= data;
+    crc ^= (crc & 0xFF) >> 4;
+    crc ^= crc << 12;
+    crc ^= (crc & 0xFF) << 5;
+    return crc;
+}
+
+/*
+ * Function: packet_rx_reset()
+ *
+ * Description: Gets the decoder ready for the first byte of a frame
+ *
+ * Returns: Nothing
+ */
+static void packet_rx_reset()
+{
+    packet_rx_length = 0;
+    packet_rx_code = 0;
+    packet_rx_zero = false;
+    packet_rx_discard = false;
+    packet_rx_crc = PACKET_CRC_INIT;
+}
+
+/*
+ * Function: packet_rx_store()
+ *
+ * Description: Adds a decoded byte to the frame being received
+ *
+ * Returns: Nothing
+ */
+static void packet_rx_store(uint8_t data)
+{
+    if (packet_rx_length >= PACKET_MAX_FRAME)
+    {
+        packet_stats.framing_errors++;
+        packet_rx_discard = true;
+        return;
+    }
+    packet_rx_frames[packet_rx_fill][packet_rx_length++] = data;
+    packet_rx_crc = PacketCrc16(packet_rx_crc, data);
+}
+
+/*
+ * Function: packet_rx_end()
+ *
+ * Description: Checks the frame ended by a delimiter and hands it over if
+ * it is good
+ *
+ * Returns: Nothing
+ */
+static void packet_rx_end()
+{
+    uint8_t *frame = packet_rx_frames[packet_rx_fill];
+
+    if (packet_rx_discard || (packet_rx_length == 0))
+    {
+        /* Already counted, or just an extra delimiter */
+        return;
+    }
+    if ((packet_rx_code != 0) || (packet_rx_length < PACKET_OVERHEAD))
+    {
+        packet_stats.framing_errors++;
+        return;
+    }
+    if (packet_rx_crc != 0)
+    {
+        packet_stats.crc_errors++;
+        return;
+    }
+
+    if (packet_rx_synced && (frame[0] != packet_rx_sequence))
+    {
+        packet_stats.sequence_gaps++;
+    }
+    packet_rx_sequence = frame[0] + 1;
+    packet_rx_synced = true;
+
+    if (packet_rx_ready)
+    {
+        packet_stats.dropped++;
+        return;
+    }
+    packet_rx_ready_length = packet_rx_length;
+    packet_rx_fill ^= 1;
+    packet_rx_ready = true;
+    packet_stats.received++;
+}
+
+/*
+ * Function: packet_rx_byte()
+ *
+ * Description: COBS decoder fed from the USART Receive Complete interrupt.
+ * A code byte n is followed by n - 1 data bytes and, unless n is 0xFF, a
+ * 0x00 that is only stored once the next block starts, as the last block
+ * of a frame has none.
+ *
+ * Returns: Nothing
+ */
+static void packet_rx_byte(uint8_t data)
+{
+    if (data == PACKET_DELIMITER)
+    {
+        packet_rx_end();
+        packet_rx_reset();
+    }
+    else if (packet_rx_discard)
+    {
+        /* Wait for the delimiter */
+    }
+    else if (packet_rx_code == 0)
+    {
+        if (packet_rx_zero)
+        {
+            packet_rx_store(0);
+        }
+        packet_rx_code = data - 1;
+        packet_rx_zero = (data != 0xFF);
+    }
+    else
+    {
+        packet_rx_store(data);
+        packet_rx_code--;
+    }
+}
+
+/*
+ * Function: packet_write()
+ *
+ * Description: Queues bytes in the USART transmit ring buffer, waiting
+ * while it is full
+ *
+ * Returns: Nothing
+ */
+static void packet_write(const uint8_t *data, uint8_t length)
+{
+    uint8_t written;
+
+    while (length)
+    {
+        written = UsartWrite(data, length);
+        data += written;
+        length -= written;
+    }
+}
+
+/*
+ * Function: PacketInit()
+ *
+ * Description: Resets the packet layer and routes the received bytes to
+ * the frame decoder. For more details see packet.h
+ *
+ * Returns: Nothing
+ */
+void PacketInit()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        packet_tx_sequence = 0;
+        packet_rx_fill = 0;
+        packet_rx_ready = false;
+        packet_rx_synced = false;
+        packet_stats.received = 0;
+        packet_stats.crc_errors = 0;
+        packet_stats.framing_errors = 0;
+        packet_stats.dropped = 0;
+        packet_stats.sequence_gaps = 0;
+        /* Start in sync, the senders put no delimiter in front of the first
+           frame. Init in the middle of a frame costs one framing or CRC
+           error, the decoder is back in step at its delimiter */
+        packet_rx_reset();
+        UsartSetRxHandler(packet_rx_byte);
+    }
+}
+
+void PacketStop()
+{
+    UsartSetRxHandler(NULL);
+}
+
+/*
+ * Function: PacketSend()
+ *
+ * Description: Builds the frame with sequence number and CRC and sends it
+ * COBS encoded, block by block straight into the USART transmit ring
+ * buffer. For more details see packet.h
+ *
+ * Returns: false if the payload is too long
+ */
+bool PacketSend(uint8_t type, const uint8_t *payload, uint8_t length)
+{
+    uint8_t frame_length = length + PACKET_OVERHEAD;
+    uint16_t crc = PACKET_CRC_INIT;
+    uint8_t start = 0;
+    uint8_t end;
+    uint8_t code;
+    uint8_t i;
+
+    if (length > PACKET_MAX_PAYLOAD)
+    {
+        return false;
+    }
+
+    packet_tx_frame[0] = packet_tx_sequence++;
+    packet_tx_frame[1] = type;
+    for (i = 0; i < length; i++)
+    {
+        packet_tx_frame[2 + i] = payload[i];
+    }
+    for (i = 0; i < frame_length - 2; i++)
+    {
+        crc = PacketCrc16(crc, packet_tx_frame[i]);
+    }
+    packet_tx_frame[frame_length - 2] = (uint8_t)(crc >> 8);
+    packet_tx_frame[frame_length - 1] = (uint8_t)crc;
+
+    for (;;)
+    {
+        end = start;
+        while ((end < frame_length) && (packet_tx_frame[end] != 0))
+        {
+            end++;
+        }
+        /* Frames are shorter than 254 bytes, so no block is ever full */
+        code = end - start + 1;
+        packet_write(&code, 1);
+        packet_write(&packet_tx_frame[start], end - start);
+        if (end >= frame_length)
+        {
+            break;
+        }
+        /* Skip the 0x00 the block stands for */
+        start = end + 1;
+    }
+
+    code = PACKET_DELIMITER;
+    packet_write(&code, 1);
+    return true;
+}
+
+/*
+ * Function: PacketReceive()
+ *
+ * Description: Hands out the frame waiting in the buffer the decoder is not
+ * using. For more details see packet.h
+ *
+ * Returns: false if no frame is waiting
+ */
+bool PacketReceive(PACKET *packet)
+{
+    const uint8_t *frame;
+
+    if (!packet_rx_ready)
+    {
+        return false;
+    }
+
+    /* The decoder has moved on to the other buffer and leaves this one alone
+     * until packet_rx_ready is cleared */
+    frame = packet_rx_frames[packet_rx_fill ^ 1];
+    packet->sequence = frame[0];
+    packet->type = frame[1];
+    packet->length = packet_rx_ready_length - PACKET_OVERHEAD;
+    packet->payload = &frame[2];
+    return true;
+}
+
+void PacketRelease()
+{
+    packet_rx_ready = false;
+}
+
+/*
+ * Function: PacketGetStats()
+ *
+ * Description: Copies the receive counters, with interrupts off as the ISR
+ * updates them. For more details see packet.h
+ *
+ * Returns: Nothing
+ */
+void PacketGetStats(PACKET_STATS *stats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        stats->received = packet_stats.received;
+        stats->crc_errors = packet_stats.crc_errors;
+        stats->framing_errors = packet_stats.framing_errors;
+        stats->dropped = packet_stats.dropped;
+        stats->sequence_gaps = packet_stats.sequence_gaps;
+    }
+}
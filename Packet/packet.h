@@ -0,0 +1,120 @@
+/************************************************************************
+ * Name : packet.h
+ *
+ * Header file for the packet.c file
+ *
+ * Contains the frame format, macros and function definitions for exchanging
+ * binary commands and data with a host over the USART
+ ************************************************************************/
+/************
+Frame format
+
+	Before encoding a frame is :
+
+	---------------------------------------------------
+	| SEQ | TYPE | PAYLOAD (0..PACKET_MAX_PAYLOAD) | CRC |
+	---------------------------------------------------
+	SEQ     : Sequence counter, incremented for every frame sent, so the
+	          receiver can count lost frames
+	TYPE    : Application defined frame type / command
+	PAYLOAD : Application data
+	CRC     : CRC-16/CCITT-FALSE (polynomial 0x1021, start 0xFFFF, no final
+	          xor) over SEQ, TYPE and PAYLOAD, high byte first. Run over the
+	          whole frame including the CRC the result is 0.
+
+	The frame is then COBS (Consistent Overhead Byte Stuffing) encoded, which
+	removes every 0x00 byte at the cost of one byte per 254, and ends with a
+	0x00 delimiter. A receiver that gets out of step is back in sync at the
+	next 0x00, so no escaping or timeouts are needed.
+
+	A reference encoder/decoder for the host side is in host/packetref.c
+*************/
+
+#ifndef _PACKET_H_
+#define _PACKET_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Maximum payload of a frame, SEQ, TYPE and CRC come on top */
+#define PACKET_MAX_PAYLOAD 64
+
+#define PACKET_OVERHEAD 4
+#define PACKET_MAX_FRAME (PACKET_MAX_PAYLOAD + PACKET_OVERHEAD)
+#define PACKET_DELIMITER 0x00
+#define PACKET_CRC_INIT 0xFFFF
+
+#if PACKET_MAX_FRAME > 254
+#error "PACKET_MAX_PAYLOAD has to be 250 or less"
+#endif
+
+/* A received frame, valid until PacketRelease() */
+typedef struct
+{
+    uint8_t sequence;
+    uint8_t type;
+    uint8_t length;
+    const uint8_t *payload;
+}PACKET;
+
+/* Receive counters, see PacketGetStats() */
+typedef struct
+{
+    uint16_t received;      /* Frames handed to the application */
+    uint16_t crc_errors;    /* Frames with a wrong CRC */
+    uint16_t framing_errors;/* Frames too short, too long or badly encoded */
+    uint16_t dropped;       /* Good frames lost as the last one was not released */
+    uint16_t sequence_gaps; /* Frames with a sequence number not following the last */
+}PACKET_STATS;
+
+/** @brief Reset the packet layer and take over the USART receiver
+ *
+ * The USART has to be set up with UsartInit() before. From here on every
+ * received byte goes through the frame decoder in the receive interrupt,
+ * UsartRead()/UsartReceive() get no data. The first byte received is taken
+ * as the start of a frame, the tail of a frame already under way is counted
+ * as one framing or CRC error.
+ */
+void PacketInit();
+
+/** @brief Stop decoding frames, the received bytes go to the USART receive
+ * ring buffer again
+ */
+void PacketStop();
+
+/** @brief Build, encode and send a frame
+ *
+ * The encoded frame is queued in the USART transmit ring buffer, the
+ * function waits only while the ring buffer is full
+ * @param type Frame type
+ * @param payload Payload bytes, may be NULL if length is 0
+ * @param length Payload length, at most PACKET_MAX_PAYLOAD
+ * @return false if the payload is too long
+ */
+bool PacketSend(uint8_t type, const uint8_t *payload, uint8_t length);
+
+/** @brief Get the next received frame
+ *
+ * Frames are decoded and CRC checked in the receive interrupt, this only
+ * hands a finished one out. The frame stays valid until PacketRelease(),
+ * meanwhile the next frame is being received into the second buffer.
+ * @param packet Filled in with the frame
+ * @return false if no frame is waiting
+ */
+bool PacketReceive(PACKET *packet);
+
+/** @brief Give the frame got with PacketReceive() back to the receiver */
+void PacketRelease();
+
+/** @brief Copy the receive counters
+ * @param stats Filled in with the counters
+ */
+void PacketGetStats(PACKET_STATS *stats);
+
+/** @brief Update a CRC-16/CCITT-FALSE with one byte
+ * @param crc CRC so far, PACKET_CRC_INIT to start
+ * @return the new CRC
+ */
+uint16_t PacketCrc16(uint16_t crc, uint8_t data);
+
+#endif
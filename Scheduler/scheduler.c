@@ -0,0 +1,275 @@
+/*
+ * File : scheduler.c
+ *
+ * Description:
+ * File contains the necessary functions for a cooperative run to completion
+ * scheduler with per task event queues
+ *
+ * Note:
+ * For detail documentation about the working and the use of the scheduler
+ * refer the header file scheduler.h
+ * Refer to E:/Avrprojects/library/coding standards.doc for coding standards
+ *
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "timer.h"
+#include "scheduler.h"
+
+#if (SCHEDULER_MAX_TASKS < 1) || (SCHEDULER_MAX_TASKS > 8)
+#error "SCHEDULER_MAX_TASKS has to be from 1 to 8"
+#endif
+#if (SCHEDULER_QUEUE_SIZE & (SCHEDULER_QUEUE_SIZE - 1)) || (SCHEDULER_QUEUE_SIZE < 2) || (SCHEDULER_QUEUE_SIZE > 128)
+#error "SCHEDULER_QUEUE_SIZE has to be a power of two from 2 to 128"
+#endif
+#if SCHEDULER_SOFT_TIMERS && !TIMER_SYSTEM_CLOCK
+#error "The soft timers run on the system clock, set TIMER_SYSTEM_CLOCK in timerconfig.h"
+#endif
+
+#define SCHEDULER_QUEUE_MASK (SCHEDULER_QUEUE_SIZE - 1)
+
+static SCHEDULER_TASK scheduler_tasks[SCHEDULER_MAX_TASKS];
+
+/* Event queues, free running head and tail as in the USART rings. The head
+ * is moved by SchedulerPost() and the tail by SchedulerDispatch(), both with
+ * the interrupts off as either can run in the main context and in an ISR */
+static uint8_t scheduler_events[SCHEDULER_MAX_TASKS][SCHEDULER_QUEUE_SIZE];
+static uint16_t scheduler_values[SCHEDULER_MAX_TASKS][SCHEDULER_QUEUE_SIZE];
+static uint8_t scheduler_head[SCHEDULER_MAX_TASKS];
+static uint8_t scheduler_tail[SCHEDULER_MAX_TASKS];
+
+/* Bit n is set while task n has events waiting */
+static volatile uint8_t scheduler_ready;
+static volatile uint16_t scheduler_dropped;
+static SCHEDULER_IDLE_HOOK scheduler_idle_hook;
+
+#if SCHEDULER_SOFT_TIMERS
+/* Millisecond the soft timers were last run for */
+static uint32_t scheduler_serviced;
+
+/*
+ * Function: scheduler_timer_expired()
+ *
+ * Description: Soft timer callback, the context holds the task in the high
+ * byte and the event in the low byte
+ *
+ * Returns: Nothing
+ */
+static void scheduler_timer_expired(void *context)
+{
+    uint16_t target = (uint16_t)(uintptr_t)context;
+
+    SchedulerPost((uint8_t)(target >> 8), (uint8_t)target, (uint16_t)TimerMillis());
+}
+
+SOFTTIMER SchedulerCreateTimer(uint8_t task, uint8_t event)
+{
+    return SoftTimerCreate(scheduler_timer_expired, (void *)(uintptr_t)(((uint16_t)task << 8) | event));
+}
+#endif
+
+/*
+ * Function: SchedulerInit()
+ *
+ * Description: Removes all tasks and events, sets the sleep mode and with
+ * SCHEDULER_SOFT_TIMERS empties the soft timers too
+ *
+ * Returns: Nothing
+ */
+void SchedulerInit()
+{
+    uint8_t i;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        for (i = 0; i < SCHEDULER_MAX_TASKS; i++)
+        {
+            scheduler_tasks[i] = NULL;
+            scheduler_head[i] = 0;
+            scheduler_tail[i] = 0;
+        }
+        scheduler_ready = 0;
+        scheduler_dropped = 0;
+    }
+    scheduler_idle_hook = NULL;
+    set_sleep_mode(SCHEDULER_SLEEP_MODE);
+
+#if SCHEDULER_SOFT_TIMERS
+    SoftTimerInit();
+    scheduler_serviced = TimerMillis();
+#endif
+}
+
+bool SchedulerAddTask(uint8_t priority, SCHEDULER_TASK task)
+{
+    if ((priority >= SCHEDULER_MAX_TASKS) || (scheduler_tasks[priority] != NULL) || (task == NULL))
+    {
+        return false;
+    }
+    scheduler_tasks[priority] = task;
+    return true;
+}
+
+/*
+ * Function: SchedulerPost()
+ *
+ * Description: Puts the event in the task queue and marks the task ready.
+ * The interrupts are kept off only for the few stores, an ISR can post
+ * while the main context is posting to the same task
+ *
+ * Returns: false if the task does not exist or the queue is full
+ */
+bool SchedulerPost(uint8_t task, uint8_t event, uint16_t value)
+{
+    bool posted = false;
+    uint8_t slot;
+
+    if ((task >= SCHEDULER_MAX_TASKS) || (scheduler_tasks[task] == NULL))
+    {
+        return false;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if ((uint8_t)(scheduler_head[task] - scheduler_tail[task]) < SCHEDULER_QUEUE_SIZE)
+        {
+            slot = scheduler_head[task] & SCHEDULER_QUEUE_MASK;
+            scheduler_events[task][slot] = event;
+            scheduler_values[task][slot] = value;
+            scheduler_head[task]++;
+            scheduler_ready |= (uint8_t)(1 << task);
+            posted = true;
+        }
+        else
+        {
+            scheduler_dropped++;
+        }
+    }
+    return posted;
+}
+
+void SchedulerSetIdleHook(SCHEDULER_IDLE_HOOK hook)
+{
+    scheduler_idle_hook = hook;
+}
+
+/*
+ * Function: SchedulerDispatch()
+ *
+ * Description: Takes the oldest event of the highest priority ready task
+ * out of its queue and runs the handler with the interrupts on. Only one
+ * event is handed out per call so a task that became ready meanwhile with
+ * a higher priority goes next
+ *
+ * Returns: false if no task had an event
+ */
+bool SchedulerDispatch()
+{
+    uint8_t ready;
+    uint8_t task;
+    uint8_t slot;
+    uint8_t event;
+    uint16_t value;
+
+    ready = scheduler_ready;
+    if (!ready)
+    {
+        return false;
+    }
+
+    /* Lowest set bit is the highest priority */
+    for (task = 0; !(ready & 0x01); task++)
+    {
+        ready >>= 1;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        slot = scheduler_tail[task] & SCHEDULER_QUEUE_MASK;
+        event = scheduler_events[task][slot];
+        value = scheduler_values[task][slot];
+        scheduler_tail[task]++;
+        if (scheduler_tail[task] == scheduler_head[task])
+        {
+            scheduler_ready &= (uint8_t)~(1 << task);
+        }
+    }
+
+    scheduler_tasks[task](event, value);
+    return true;
+}
+
+/*
+ * Function: scheduler_idle()
+ *
+ * Description: Sleeps until the next interrupt. The check and the sleep are
+ * done with the interrupts off and sei() right before sleep_cpu(), the
+ * instruction after sei always runs, so an event posted by an ISR after the
+ * check can not be slept over. A tick since the soft timers were run keeps
+ * it awake too
+ *
+ * Returns: Nothing
+ */
+static void scheduler_idle()
+{
+    bool sleep;
+
+    if ((scheduler_idle_hook != NULL) && !scheduler_idle_hook())
+    {
+        return;
+    }
+
+    cli();
+    sleep = !scheduler_ready;
+#if SCHEDULER_SOFT_TIMERS
+    sleep = sleep && (TimerMillis() == scheduler_serviced);
+#endif
+    if (sleep)
+    {
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+    }
+    sei();
+}
+
+/*
+ * Function: SchedulerRun()
+ *
+ * Description: The scheduler loop, runs the expired soft timers (which may
+ * post events), hands out the events and sleeps when nothing is left
+ *
+ * Returns: Does not return
+ */
+void SchedulerRun()
+{
+    for (;;)
+    {
+#if SCHEDULER_SOFT_TIMERS
+        scheduler_serviced = TimerMillis();
+        SoftTimerService();
+#endif
+        if (!SchedulerDispatch())
+        {
+            scheduler_idle();
+        }
+    }
+}
+
+uint16_t SchedulerDroppedEvents()
+{
+    uint16_t dropped;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        dropped = scheduler_dropped;
+    }
+    return dropped;
+}
@@ -0,0 +1,148 @@
+/************************************************************************
+ * Name : scheduler.h
+ *
+ * Header file for the scheduler.c file
+ *
+ * Contains the macros, types and function definitions for a cooperative
+ * run to completion scheduler. Every task has a priority of its own and a
+ * fixed size queue of events. Interrupts only post an event and return, the
+ * work is done by the task handler in the main context. The scheduler always
+ * hands the next event to the highest priority task that has one, a handler
+ * is never interrupted by another task, and sleeps when there is nothing to
+ * do. The millisecond tick of timer.c wakes it and drives the soft timers.
+ ************************************************************************/
+/************
+Usage
+
+	enum { TASK_MOTOR, TASK_SENSOR, TASK_COMMS };        // priorities, 0 first
+	enum { EV_ADC, EV_RX_BYTE, EV_SAMPLE_TIME };
+
+	static void AdcDone(uint8_t channel, uint16_t value)  // ADC ISR
+	{
+		SchedulerPost(TASK_SENSOR, EV_ADC, value);
+	}
+	static void RxByte(uint8_t byte)                      // USART RX ISR
+	{
+		SchedulerPost(TASK_COMMS, EV_RX_BYTE, byte);
+	}
+	static void SensorTask(uint8_t event, uint16_t value)
+	{
+		if (event == EV_SAMPLE_TIME)
+			AdcStartAsync(0, AdcDone);
+		else
+			... filter value ...
+	}
+
+	TimerInit();
+	SchedulerInit();
+	SchedulerAddTask(TASK_MOTOR, MotorTask);
+	SchedulerAddTask(TASK_SENSOR, SensorTask);
+	SchedulerAddTask(TASK_COMMS, CommsTask);
+	SoftTimerStart(SchedulerCreateTimer(TASK_SENSOR, EV_SAMPLE_TIME), 10, 10);
+	UsartSetRxHandler(RxByte);
+	sei();
+	SchedulerRun();                                       // never returns
+
+	A handler gets one event per call and should return quickly, a long
+	handler holds up every other task. A full queue drops the event, the
+	poster gets false and SchedulerDroppedEvents() counts it.
+*************/
+
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/sleep.h>
+#include "timer.h"
+
+/* Number of tasks, which are also the priorities 0 (first) to
+ * SCHEDULER_MAX_TASKS - 1. At most 8 */
+#define SCHEDULER_MAX_TASKS 8
+/* Events each task can have waiting, has to be a power of two from 2 to 128.
+ * Every event takes 3 bytes */
+#define SCHEDULER_QUEUE_SIZE 8
+/* 1 to run the soft timers of softtimer.c from the scheduler loop and to
+ * have SchedulerCreateTimer(), needs TIMER_SYSTEM_CLOCK in timerconfig.h */
+#define SCHEDULER_SOFT_TIMERS TIMER_SYSTEM_CLOCK
+/* Sleep mode when idle. It has to keep timer 0 running for the system
+ * clock, on the ATmega32 that is SLEEP_MODE_IDLE only */
+#define SCHEDULER_SLEEP_MODE SLEEP_MODE_IDLE
+
+/* Task handler, called with one event from the task queue */
+typedef void (*SCHEDULER_TASK)(uint8_t event, uint16_t value);
+
+/* Called before the scheduler sleeps, return false to stay awake */
+typedef bool (*SCHEDULER_IDLE_HOOK)(void);
+
+/** @brief Removes all tasks and events and sets the sleep mode
+ *
+ * @param void accepts nothing
+ * @return returns nothing
+ */
+void SchedulerInit();
+
+/** @brief Adds a task
+ *
+ * @param priority Priority of the task, 0 is the highest. It is also the
+ * task number used to post events
+ * @param task Handler of the task events
+ * @return false if the priority is out of range or taken
+ */
+bool SchedulerAddTask(uint8_t priority, SCHEDULER_TASK task);
+
+/** @brief Queues an event for a task, from an ISR or the main context
+ *
+ * @param task The task (its priority)
+ * @param event Event number, up to the application
+ * @param value Event data, e.g. the ADC result or the received byte
+ * @return false if the task does not exist or its queue is full
+ */
+bool SchedulerPost(uint8_t task, uint8_t event, uint16_t value);
+
+/** @brief Sets a function called each time before the scheduler sleeps
+ *
+ * @param hook The function, NULL for none
+ * @return returns nothing
+ */
+void SchedulerSetIdleHook(SCHEDULER_IDLE_HOOK hook);
+
+/** @brief Hands one event to the highest priority task that has one
+ *
+ * SchedulerRun() calls it in a loop, an application with its own main loop
+ * can call it instead.
+ * @param void accepts nothing
+ * @return false if no task had an event
+ */
+bool SchedulerDispatch();
+
+/** @brief Runs the scheduler, never returns
+ *
+ * Global interrupts have to be enabled.
+ * @param void accepts nothing
+ * @return does not return
+ */
+void SchedulerRun();
+
+/** @brief Number of events dropped because of a full queue
+ *
+ * @param void accepts nothing
+ * @return the count
+ */
+uint16_t SchedulerDroppedEvents();
+
+#if SCHEDULER_SOFT_TIMERS
+#include "softtimer.h"
+
+/** @brief Creates a soft timer that posts an event when it expires
+ *
+ * Start it with SoftTimerStart(). The event value is the low 16 bits of
+ * TimerMillis() at expiry.
+ * @param task The task to post to
+ * @param event The event posted
+ * @return the timer, SOFTTIMER_NONE if the soft timer pool is used up
+ */
+SOFTTIMER SchedulerCreateTimer(uint8_t task, uint8_t event);
+#endif
+
+#endif
@@ -0,0 +1,424 @@
+/*
+ * File : softuart.c
+ *
+ * Description:
+ * File contains a software UART driven by the Timer1 compare match and
+ * input capture interrupts
+ *
+ * Note:
+ * For detail documentation about the working and the use of the software
+ * UART refer the header file softuart.h
+ * Refer to E:/Avrprojects/library/coding standards.doc for coding standards
+ *
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "softuartpinconfig.h"
+#include "softuart.h"
+
+#if (SOFTUART_TX_BUFFER_SIZE & (SOFTUART_TX_BUFFER_SIZE - 1)) || (SOFTUART_TX_BUFFER_SIZE > 128)
+#error "SOFTUART_TX_BUFFER_SIZE has to be a power of two not more than 128"
+#endif
+#if (SOFTUART_RX_BUFFER_SIZE & (SOFTUART_RX_BUFFER_SIZE - 1)) || (SOFTUART_RX_BUFFER_SIZE > 128)
+#error "SOFTUART_RX_BUFFER_SIZE has to be a power of two not more than 128"
+#endif
+#define SOFTUART_TX_BUFFER_MASK (SOFTUART_TX_BUFFER_SIZE - 1)
+#define SOFTUART_RX_BUFFER_MASK (SOFTUART_RX_BUFFER_SIZE - 1)
+
+/* Start bit, 8 data bits and the stop bit */
+#define SOFTUART_FRAME_BITS 10
+/* Shortest bit time in CPU cycles the ISRs can keep up with */
+#define SOFTUART_MIN_BIT_CYCLES 200UL
+/* Longest bit time in timer ticks, the middle of the first data bit (1.5
+ * bit times after the start edge) has to be reachable by OCR1B */
+#define SOFTUART_MAX_BIT_TICKS 43690UL
+/* Cycles from the INT0 edge to reading TCNT1 in the ISR */
+#define SOFTUART_INT0_LATENCY_CYCLES 20
+
+#define TxHigh() (SOFTUART_TX_PORT |= (1<<SOFTUART_TX_PIN))
+#define TxLow() (SOFTUART_TX_PORT &= ~(1<<SOFTUART_TX_PIN))
+#define RxLevel() (SOFTUART_RX_PIN_REG & (1<<SOFTUART_RX_PIN))
+
+/* Start bit detection on the input capture or the INT0 falling edge */
+#if SOFTUART_RX_ON_INT0
+#define StartDetectOn() do { GIFR = (1<<INTF0); GICR |= (1<<INT0); } while(0)
+#define StartDetectOff() (GICR &= ~(1<<INT0))
+#else
+#define StartDetectOn() do { TIFR = (1<<ICF1); TIMSK |= (1<<TICIE1); } while(0)
+#define StartDetectOff() (TIMSK &= ~(1<<TICIE1))
+#endif
+
+/* Ring buffers, head written by the producer and tail by the consumer only */
+static volatile uint8_t softuart_tx_buffer[SOFTUART_TX_BUFFER_SIZE];
+static volatile uint8_t softuart_tx_head;
+static volatile uint8_t softuart_tx_tail;
+static volatile uint8_t softuart_rx_buffer[SOFTUART_RX_BUFFER_SIZE];
+static volatile uint8_t softuart_rx_head;
+static volatile uint8_t softuart_rx_tail;
+
+/* One bit time in Timer1 ticks */
+static uint16_t softuart_bit_ticks;
+#if SOFTUART_RX_ON_INT0
+static uint8_t softuart_int0_latency;
+#endif
+
+/* Transmitter state, the frame is sent LSB first */
+static volatile bool softuart_tx_busy;
+static uint16_t softuart_tx_frame;
+static uint8_t softuart_tx_bits;
+
+/* Receiver state */
+static uint8_t softuart_rx_data;
+static uint8_t softuart_rx_bits;
+
+static volatile SOFTUART_STATS softuart_stats;
+
+/*
+ * Function: SoftUartInit()
+ *
+ * Description: Works out the bit time, sets up the pins and Timer1 and
+ * turns on the start bit detection. For more details see softuart.h
+ *
+ * Returns: false if the baud rate can not be made
+ */
+bool SoftUartInit(uint32_t baud)
+{
+    uint32_t ticks = (F_CPU + baud / 2) / baud;
+    uint8_t clock = (1<<CS10);
+
+    if (ticks < SOFTUART_MIN_BIT_CYCLES)
+    {
+        return false;
+    }
+    /* Without prescaling a slow baud rate does not fit 16 bits */
+    if (ticks >= SOFTUART_MAX_BIT_TICKS)
+    {
+        ticks = (ticks + 4) / 8;
+        clock = (1<<CS11);
+        if (ticks >= SOFTUART_MAX_BIT_TICKS)
+        {
+            return false;
+        }
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        softuart_bit_ticks = (uint16_t)ticks;
+        softuart_tx_head = 0;
+        softuart_tx_tail = 0;
+        softuart_rx_head = 0;
+        softuart_rx_tail = 0;
+        softuart_tx_busy = false;
+        softuart_tx_bits = 0;
+        softuart_stats.frame_errors = 0;
+        softuart_stats.dropped = 0;
+
+        /* TX idles high, RX gets the pull-up so an open line is idle too */
+        TxHigh();
+        SOFTUART_TX_DDR |= (1<<SOFTUART_TX_PIN);
+        SOFTUART_RX_DDR &= ~(1<<SOFTUART_RX_PIN);
+        SOFTUART_RX_PORT |= (1<<SOFTUART_RX_PIN);
+
+        /* Timer1 free running in normal mode, OC1A/OC1B disconnected */
+        TIMSK &= ~((1<<TICIE1)|(1<<OCIE1A)|(1<<OCIE1B)|(1<<TOIE1));
+        TCCR1A = 0;
+#if SOFTUART_RX_ON_INT0
+        softuart_int0_latency = (clock == (1<<CS10)) ? SOFTUART_INT0_LATENCY_CYCLES
+                                                    : SOFTUART_INT0_LATENCY_CYCLES / 8;
+        TCCR1B = clock;
+        MCUCR = (MCUCR & ~((1<<ISC01)|(1<<ISC00))) | (1<<ISC01);
+#else
+        /* Capture on the falling edge with the noise canceler */
+        TCCR1B = clock | (1<<ICNC1);
+#endif
+        StartDetectOn();
+    }
+    return true;
+}
+
+/*
+ * Function: SoftUartStop()
+ *
+ * Description: Turns off the interrupts and Timer1, the TX pin is left
+ * idle (high)
+ *
+ * Returns: Nothing
+ */
+void SoftUartStop()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        StartDetectOff();
+        TIMSK &= ~((1<<OCIE1A)|(1<<OCIE1B));
+        TCCR1B = 0;
+        TxHigh();
+        softuart_tx_busy = false;
+        softuart_tx_bits = 0;
+        softuart_tx_tail = softuart_tx_head;
+    }
+}
+
+/*
+ * Function: softuart_tx_start()
+ *
+ * Description: Starts the bit timing if the transmitter is idle, the first
+ * compare match one bit time from now takes the byte out of the ring buffer
+ *
+ * Returns: Nothing
+ */
+static void softuart_tx_start()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if (!softuart_tx_busy)
+        {
+            softuart_tx_busy = true;
+            OCR1A = TCNT1 + softuart_bit_ticks;
+            TIFR = (1<<OCF1A);
+            TIMSK |= (1<<OCIE1A);
+        }
+    }
+}
+
+/*
+ * Function: SoftUartWrite()
+ *
+ * Description: Copies as many bytes as fit into the transmit ring buffer
+ * and starts the transmitter
+ *
+ * Returns: The number of bytes queued
+ */
+uint8_t SoftUartWrite(const uint8_t *data, uint8_t length)
+{
+    uint8_t head = softuart_tx_head;
+    uint8_t free = SOFTUART_TX_BUFFER_SIZE - (uint8_t)(head - softuart_tx_tail);
+    uint8_t i;
+
+    if (length > free)
+    {
+        length = free;
+    }
+
+    for (i = 0; i < length; i++)
+    {
+        softuart_tx_buffer[head & SOFTUART_TX_BUFFER_MASK] = data[i];
+        head++;
+    }
+    softuart_tx_head = head;
+
+    if (length)
+    {
+        softuart_tx_start();
+    }
+    return length;
+}
+
+/*
+ * Function: SoftUartRead()
+ *
+ * Description: Copies the received bytes out of the ring buffer
+ *
+ * Returns: The number of bytes copied
+ */
+uint8_t SoftUartRead(uint8_t *data, uint8_t length)
+{
+    uint8_t tail = softuart_rx_tail;
+    uint8_t count = (uint8_t)(softuart_rx_head - tail);
+    uint8_t i;
+
+    if (length > count)
+    {
+        length = count;
+    }
+
+    for (i = 0; i < length; i++)
+    {
+        data[i] = softuart_rx_buffer[tail & SOFTUART_RX_BUFFER_MASK];
+        tail++;
+    }
+    softuart_rx_tail = tail;
+    return length;
+}
+
+uint8_t SoftUartAvailable()
+{
+    return (uint8_t)(softuart_rx_head - softuart_rx_tail);
+}
+
+void SoftUartSend(uint8_t data)
+{
+    while (SoftUartWrite(&data, 1) == 0);
+}
+
+uint8_t SoftUartReceive()
+{
+    uint8_t data;
+
+    while (SoftUartRead(&data, 1) == 0);
+    return data;
+}
+
+void SoftUartSendString(const char *msg)
+{
+    while (*msg != '\0')
+    {
+        SoftUartSend((uint8_t)*msg);
+        msg++;
+    }
+}
+
+void SoftUartSendString_P(const char *msg)
+{
+    char c;
+
+    while ((c = pgm_read_byte(msg)) != '\0')
+    {
+        SoftUartSend((uint8_t)c);
+        msg++;
+    }
+}
+
+void SoftUartFlush()
+{
+    while (softuart_tx_busy);
+}
+
+/*
+ * Function: SoftUartGetStats()
+ *
+ * Description: Copies the receive error counters, with interrupts off as
+ * the ISR updates them
+ *
+ * Returns: Nothing
+ */
+void SoftUartGetStats(SOFTUART_STATS *stats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        stats->frame_errors = softuart_stats.frame_errors;
+        stats->dropped = softuart_stats.dropped;
+    }
+}
+
+/*
+ * Function: softuart_rx_start_bit()
+ *
+ * Description: Called with the time of the start bit edge. Turns the edge
+ * detection off and sets Output Compare B to the middle of the first data
+ * bit
+ *
+ * Returns: Nothing
+ */
+static void softuart_rx_start_bit(uint16_t edge)
+{
+    StartDetectOff();
+    softuart_rx_bits = 0;
+    softuart_rx_data = 0;
+    OCR1B = edge + softuart_bit_ticks + (softuart_bit_ticks >> 1);
+    TIFR = (1<<OCF1B);
+    TIMSK |= (1<<OCIE1B);
+}
+
+#if SOFTUART_RX_ON_INT0
+/*
+ * INT0 falling edge, start bit. TCNT1 is read as early as possible and
+ * corrected by the ISR entry time
+ */
+ISR(INT0_vect)
+{
+    softuart_rx_start_bit(TCNT1 - softuart_int0_latency);
+}
+#else
+/*
+ * Timer1 input capture, start bit. ICR1 holds the time of the edge
+ */
+ISR(TIMER1_CAPT_vect)
+{
+    softuart_rx_start_bit(ICR1);
+}
+#endif
+
+/*
+ * Timer1 Output Compare B, middle of a received bit. Shifts in the data
+ * bits LSB first, at the stop bit the byte is stored and the start bit
+ * detection turned back on
+ */
+ISR(TIMER1_COMPB_vect)
+{
+    uint8_t level = RxLevel();
+    uint8_t head;
+
+    if (softuart_rx_bits < 8)
+    {
+        softuart_rx_data >>= 1;
+        if (level)
+        {
+            softuart_rx_data |= 0x80;
+        }
+        softuart_rx_bits++;
+        OCR1B += softuart_bit_ticks;
+        return;
+    }
+
+    TIMSK &= ~(1<<OCIE1B);
+    if (!level)
+    {
+        softuart_stats.frame_errors++;
+    }
+    else
+    {
+        head = softuart_rx_head;
+        if ((uint8_t)(head - softuart_rx_tail) < SOFTUART_RX_BUFFER_SIZE)
+        {
+            softuart_rx_buffer[head & SOFTUART_RX_BUFFER_MASK] = softuart_rx_data;
+            softuart_rx_head = head + 1;
+        }
+        else
+        {
+            softuart_stats.dropped++;
+        }
+    }
+    StartDetectOn();
+}
+
+/*
+ * Timer1 Output Compare A, one bit time has passed. Sets the TX pin to the
+ * next bit, after the stop bit the next byte is taken out of the ring
+ * buffer or the transmitter goes idle
+ */
+ISR(TIMER1_COMPA_vect)
+{
+    uint8_t tail;
+
+    if (softuart_tx_bits == 0)
+    {
+        tail = softuart_tx_tail;
+        if (tail == softuart_tx_head)
+        {
+            TIMSK &= ~(1<<OCIE1A);
+            softuart_tx_busy = false;
+            return;
+        }
+        /* Start bit (0) in bit 0, stop bit (1) in bit 9 */
+        softuart_tx_frame = ((uint16_t)softuart_tx_buffer[tail & SOFTUART_TX_BUFFER_MASK] << 1) | 0x200;
+        softuart_tx_tail = tail + 1;
+        softuart_tx_bits = SOFTUART_FRAME_BITS;
+    }
+
+    if (softuart_tx_frame & 1)
+    {
+        TxHigh();
+    }
+    else
+    {
+        TxLow();
+    }
+    softuart_tx_frame >>= 1;
+    softuart_tx_bits--;
+    OCR1A += softuart_bit_ticks;
+}
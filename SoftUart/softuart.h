@@ -0,0 +1,85 @@
+/************************************************************************
+ * Name : softuart.h
+ *
+ * Header file for the softuart.c file
+ *
+ * Contains the macros and function definitions for a software UART, a
+ * second serial channel next to the USART, e.g. for a GPS or a sensor.
+ * The frame format is fixed to 8 data bits, no parity, 1 stop bit.
+ ************************************************************************/
+/************
+How it works
+
+	Timer1 runs freely from the CPU clock and is used by the software UART
+	only, it can not be used with the timer functions at the same time.
+
+	TX : The Output Compare A interrupt fires once per bit time and sets the
+	     TX pin to the next bit of the frame, OCR1A is moved on by one bit
+	     time each time so the bit edges do not drift with the ISR latency.
+	RX : The falling edge of the start bit is caught by the Input Capture
+	     interrupt (or INT0, see softuartpinconfig.h). Output Compare B is
+	     then set to the middle of the first data bit and samples the RX pin
+	     once per bit time. At the stop bit the byte goes into the receive
+	     ring buffer and the edge detection is turned back on.
+
+	Both directions work at the same time and all of it is interrupt driven,
+	the main loop is never blocked. There is one short interrupt per bit and
+	direction, full duplex at 19200 baud is 38400 interrupts a second or
+	roughly 15% of a 16 MHz CPU, half of that at 9600 baud. Other interrupts
+	delay the bit edges by their run time, which has to stay well below a
+	quarter bit time (13 us at 19200 baud).
+	The TIMSK register is shared with the other timers, code changing it
+	outside of an ISR has to do so with the interrupts turned off.
+*************/
+
+#ifndef _SOFTUART_H_
+#define _SOFTUART_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+
+/* Sizes of the transmit and receive ring buffers, have to be powers of two
+ * not more than 128 */
+#define SOFTUART_TX_BUFFER_SIZE 32
+#define SOFTUART_RX_BUFFER_SIZE 32
+
+/* Receive error counters, see SoftUartGetStats() */
+typedef struct
+{
+    uint16_t frame_errors;  /* Bytes without a stop bit, dropped */
+    uint16_t dropped;       /* Good bytes lost as the receive ring buffer was full */
+}SOFTUART_STATS;
+
+/** @brief Set up Timer1 and the pins and start the receiver
+ *
+ * Global interrupts have to be enabled (sei()) after it.
+ * @param baud Baud rate, e.g. 9600 or 19200
+ * @return false if the baud rate can not be made with Timer1
+ */
+bool SoftUartInit(uint32_t baud);
+
+/** @brief Stop Timer1 and the software UART, queued bytes are dropped */
+void SoftUartStop();
+
+/* The same as UsartSend(), UsartReceive() etc. for the software UART.
+ * SoftUartWrite()/SoftUartRead() never wait, SoftUartSend() and
+ * SoftUartReceive() wait for space in or data from the ring buffers.
+ * None of them is meant to be called from an ISR.
+ */
+void SoftUartSend(uint8_t data);
+uint8_t SoftUartReceive();
+void SoftUartSendString(const char *msg);
+void SoftUartSendString_P(const char *msg);
+#define SoftUartSendStringF(msg) SoftUartSendString_P(PSTR(msg))
+uint8_t SoftUartWrite(const uint8_t *data, uint8_t length);
+uint8_t SoftUartRead(uint8_t *data, uint8_t length);
+uint8_t SoftUartAvailable();
+
+/** @brief Wait until every queued byte has been sent */
+void SoftUartFlush();
+
+/** @brief Copy the receive error counters */
+void SoftUartGetStats(SOFTUART_STATS *stats);
+
+#endif
@@ -0,0 +1,37 @@
+/************************************************************************
+ * Name : softuartpinconfig.h 
+ * 
+ * Header file for the softuart.c file
+ *  
+ * Contains the pin configurations for the software UART.
+ * change this file when needed to suit the Avr controller and the board
+ ************************************************************************/
+#ifndef _SOFTUART_PIN_CONFIG_H_
+#define _SOFTUART_PIN_CONFIG_H_
+
+#include <avr/io.h>
+
+/* TX output, any port pin */
+#define SOFTUART_TX_DDR DDRC
+#define SOFTUART_TX_PORT PORTC
+#define SOFTUART_TX_PIN PC7
+
+/* RX input. The start bit is found with the Timer1 input capture, so RX is
+ * the ICP1 pin (PD6) and the edge is time stamped by the hardware. Set
+ * SOFTUART_RX_ON_INT0 to 1 to use the INT0 pin (PD2) instead, e.g. if ICP1
+ * is taken, the edge is then time stamped in the ISR a few cycles late */
+#define SOFTUART_RX_ON_INT0 0
+
+#if SOFTUART_RX_ON_INT0
+#define SOFTUART_RX_DDR DDRD
+#define SOFTUART_RX_PORT PORTD
+#define SOFTUART_RX_PIN_REG PIND
+#define SOFTUART_RX_PIN PD2
+#else
+#define SOFTUART_RX_DDR DDRD
+#define SOFTUART_RX_PORT PORTD
+#define SOFTUART_RX_PIN_REG PIND
+#define SOFTUART_RX_PIN PD6
+#endif
+
+#endif
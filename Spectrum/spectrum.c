@@ -0,0 +1,261 @@
+/*
+ * File : spectrum.c
+ *
+ * Description:
+ * File contains the fixed point FFT and Goertzel functions for the spectral
+ * analysis of ADC capture buffers
+ *
+ * Note:
+ * For detail documentation about the different functions and their use refer
+ * the header file spectrum.h
+ * Refer to E:/Avrprojects/library/coding standards.doc for coding standards
+ *
+ */
+
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "spectrum.h"
+
+/* sin(2 * pi * k / SPECTRUM_SINE_POINTS) in Q15 for three quarters of a
+ * period, the cosine is read a quarter period further on
+ */
+static const int16_t spectrum_sine[SPECTRUM_SINE_POINTS * 3 / 4] PROGMEM =
+{
+         0,   1608,   3212,   4808,   6393,   7962,   9512,  11039,
+     12539,  14010,  15446,  16846,  18204,  19519,  20787,  22005,
+     23170,  24279,  25329,  26319,  27245,  28105,  28898,  29621,
+     30273,  30852,  31356,  31785,  32137,  32412,  32609,  32728,
+     32767,  32728,  32609,  32412,  32137,  31785,  31356,  30852,
+     30273,  29621,  28898,  28105,  27245,  26319,  25329,  24279,
+     23170,  22005,  20787,  19519,  18204,  16846,  15446,  14010,
+     12539,  11039,   9512,   7962,   6393,   4808,   3212,   1608,
+         0,  -1608,  -3212,  -4808,  -6393,  -7962,  -9512, -11039,
+    -12539, -14010, -15446, -16846, -18204, -19519, -20787, -22005,
+    -23170, -24279, -25329, -26319, -27245, -28105, -28898, -29621,
+    -30273, -30852, -31356, -31785, -32137, -32412, -32609, -32728
+};
+
+#define SineQ15(index) ((int16_t)pgm_read_word(&spectrum_sine[(index)]))
+#define CosineQ15(index) SineQ15((index) + SPECTRUM_SINE_POINTS / 4)
+
+/* Q15 multiply */
+#define FixMul(a,b) ((int16_t)(((int32_t)(a) * (b)) >> 15))
+
+/*
+ * Function: SpectrumPrepare()
+ *
+ * Description: Removes the mean from the raw samples and scales them into
+ * the Q15 range. The division by the number of points is a shift as it is a
+ * power of two. For more details see spectrum.h
+ *
+ * Returns: Nothing
+ */
+void SpectrumPrepare(const uint16_t *raw, int16_t *real, int16_t *imag, uint8_t log2_points)
+{
+    uint8_t points = (uint8_t)(1 << log2_points);
+    uint32_t sum = 0;
+    int16_t mean;
+    uint8_t i;
+
+    for (i = 0; i < points; i++)
+    {
+        sum += raw[i];
+    }
+    mean = (int16_t)(sum >> log2_points);
+
+    for (i = 0; i < points; i++)
+    {
+        real[i] = (int16_t)(((int16_t)raw[i] - mean) * 32);
+        imag[i] = 0;
+    }
+}
+
+/*
+ * Function: SpectrumFft()
+ *
+ * Description: Bit reverses the input order and then runs the butterfly
+ * stages. The twiddle step in the sine table halves with every stage, every
+ * butterfly halves its inputs to keep the result in range.
+ *
+ * Returns: true if the transform was done
+ */
+bool SpectrumFft(int16_t *real, int16_t *imag, uint8_t log2_points)
+{
+    uint8_t points;
+    uint8_t i, j, m, reversed, bit;
+    uint8_t half, step, table_shift;
+    int16_t wr, wi, tr, ti, qr, qi;
+
+    if ((log2_points == 0) || (log2_points > SPECTRUM_LOG2_MAX_POINTS))
+    {
+        return false;
+    }
+    points = (uint8_t)(1 << log2_points);
+
+    /* Bit reversed reordering */
+    reversed = 0;
+    for (m = 1; m < points; m++)
+    {
+        bit = points;
+        do
+        {
+            bit >>= 1;
+        } while (reversed + bit > points - 1);
+        reversed = (reversed & (bit - 1)) + bit;
+        if (reversed > m)
+        {
+            tr = real[m];
+            real[m] = real[reversed];
+            real[reversed] = tr;
+            ti = imag[m];
+            imag[m] = imag[reversed];
+            imag[reversed] = ti;
+        }
+    }
+
+    /* Butterfly stages, half is the distance between the two inputs */
+    table_shift = SPECTRUM_LOG2_MAX_POINTS - 1;
+    for (half = 1; half < points; half = step)
+    {
+        step = half << 1;
+        for (m = 0; m < half; m++)
+        {
+            j = m << table_shift;
+            wr = CosineQ15(j) >> 1;
+            wi = -(SineQ15(j) >> 1);
+            for (i = m; i < points; i += step)
+            {
+                j = i + half;
+                tr = FixMul(wr, real[j]) - FixMul(wi, imag[j]);
+                ti = FixMul(wr, imag[j]) + FixMul(wi, real[j]);
+                qr = real[i] >> 1;
+                qi = imag[i] >> 1;
+                real[j] = qr - tr;
+                imag[j] = qi - ti;
+                real[i] = qr + tr;
+                imag[i] = qi + ti;
+            }
+        }
+        table_shift--;
+    }
+    return true;
+}
+
+void SpectrumMagnitude(int16_t *real, const int16_t *imag, uint8_t count)
+{
+    uint16_t re, im;
+    uint8_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        re = (real[i] < 0) ? -real[i] : real[i];
+        im = (imag[i] < 0) ? -imag[i] : imag[i];
+        /* max + min / 2 in place of sqrt(re^2 + im^2) */
+        real[i] = (re > im) ? (re + (im >> 1)) : (im + (re >> 1));
+    }
+}
+
+uint8_t SpectrumPeak(const int16_t *magnitude, uint8_t count)
+{
+    uint8_t peak = 1;
+    uint8_t i;
+
+    for (i = 2; i < count; i++)
+    {
+        if (magnitude[i] > magnitude[peak])
+        {
+            peak = i;
+        }
+    }
+    return peak;
+}
+
+/*
+ * Function: GoertzelInit()
+ *
+ * Description: 2 * cos(w) in Q14 is the same number as cos(w) in Q15, so the
+ * coefficient is read straight from the sine table. For more details see
+ * spectrum.h
+ *
+ * Returns: Nothing
+ */
+void GoertzelInit(GOERTZEL *detector, uint8_t bin, uint8_t log2_points)
+{
+    uint8_t index;
+
+    if (log2_points > SPECTRUM_LOG2_MAX_POINTS)
+    {
+        log2_points = SPECTRUM_LOG2_MAX_POINTS;
+    }
+    index = (uint8_t)(bin << (SPECTRUM_LOG2_MAX_POINTS - log2_points)) & (SPECTRUM_SINE_POINTS - 1);
+    /* cos(w) = cos(2 * pi - w) folds w into 0 to pi, then cos(w) =
+       sin(pi / 2 - w) up to pi / 2 and -sin(w - pi / 2) above, both read
+       from the first quarter of the table */
+    if (index > SPECTRUM_SINE_POINTS / 2)
+    {
+        index = SPECTRUM_SINE_POINTS - index;
+    }
+    if (index <= SPECTRUM_SINE_POINTS / 4)
+    {
+        detector->coefficient = SineQ15(SPECTRUM_SINE_POINTS / 4 - index);
+    }
+    else
+    {
+        detector->coefficient = -SineQ15(index - SPECTRUM_SINE_POINTS / 4);
+    }
+    detector->s1 = 0;
+    detector->s2 = 0;
+}
+
+/*
+ * Function: GoertzelUpdate()
+ *
+ * Description: s0 = x + coefficient * s1 - s2. The state can grow past 16
+ * bits so the product is split into the upper and lower part of s1 to keep
+ * it in 32 bits.
+ *
+ * Returns: Nothing
+ */
+void GoertzelUpdate(GOERTZEL *detector, int16_t sample)
+{
+    int32_t s1 = detector->s1;
+    int32_t product;
+
+    product = (int32_t)detector->coefficient * (s1 >> 14);
+    product += ((int32_t)detector->coefficient * (int16_t)(s1 & 0x3FFF)) >> 14;
+
+    detector->s1 = sample + product - detector->s2;
+    detector->s2 = s1;
+}
+
+/*
+ * Function: GoertzelPower()
+ *
+ * Description: power = s1^2 + s2^2 - coefficient * s1 * s2. Done once per
+ * block so it is worked out in 64 bits.
+ *
+ * Returns: The power in the bin, saturated to 32 bits
+ */
+uint32_t GoertzelPower(GOERTZEL *detector)
+{
+    int64_t s1 = detector->s1;
+    int64_t s2 = detector->s2;
+    int64_t power;
+
+    power = s1 * s1 + s2 * s2 - ((detector->coefficient * s1 * s2) >> 14);
+    power >>= (2 * GOERTZEL_POWER_SHIFT);
+
+    detector->s1 = 0;
+    detector->s2 = 0;
+
+    if (power < 0)
+    {
+        return 0;
+    }
+    if (power > 0xFFFFFFFFLL)
+    {
+        return 0xFFFFFFFFUL;
+    }
+    return (uint32_t)power;
+}
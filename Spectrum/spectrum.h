@@ -0,0 +1,113 @@
+/************************************************************************
+ * Name : spectrum.h
+ *
+ * Header file for the spectrum.c file
+ *
+ * Contains the macros, structures and function definitions for the fixed
+ * point spectral analysis of ADC capture buffers
+ ************************************************************************/
+/************
+Usage
+
+	The samples are captured at a fixed rate with the ADC auto trigger, e.g.
+	AdcStreamStart() with Timer1 in CTC mode and the compare match B
+	trigger (Timer0 may be running the system clock, see adc.h), and
+	collected with AdcStreamRead() into a buffer of 64 or 128 raw samples.
+
+	FFT :
+	    SpectrumPrepare() removes the DC part and scales the raw samples up
+	    into the real[] array, SpectrumFft() transforms real[]/imag[] in place
+	    and SpectrumMagnitude() turns the first half of the result into
+	    magnitudes. Bin k is the frequency k * sample_rate / points.
+	    All the arithmetic is 16 bit Q15 with 32 bit products, every stage
+	    scales the data by 1/2 so nothing overflows, the result is the
+	    spectrum divided by the number of points.
+
+	Goertzel :
+	    Checks for a single frequency (e.g. 50 Hz hum) without the memory for
+	    a full FFT. The samples are fed one at a time, right from the ADC
+	    stream, and after a block of points samples GoertzelPower() gives the
+	    power in the bin.
+
+	The twiddle factors are a sine table of SPECTRUM_SINE_POINTS entries kept
+	in flash.
+*************/
+
+#ifndef _SPECTRUM_H_
+#define _SPECTRUM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Largest FFT supported, the sine table is sized for it */
+#define SPECTRUM_LOG2_MAX_POINTS 7
+#define SPECTRUM_SINE_POINTS (1 << SPECTRUM_LOG2_MAX_POINTS)
+
+/* GoertzelPower() works the power out in 64 bits and then divides it by
+ * 2^(2 * GOERTZEL_POWER_SHIFT), so the power of a full scale 10 bit input
+ * over 128 samples fits 32 bits. The state is not shifted before squaring,
+ * in the low bins it grows too large for 32 bit squares */
+#define GOERTZEL_POWER_SHIFT 4
+
+/* Goertzel detector state, use GoertzelInit() to set it up */
+typedef struct goertzel
+{
+    int16_t coefficient; /**< 2 * cos(2 * pi * bin / points) in Q14 */
+    int32_t s1;          /**< last state */
+    int32_t s2;          /**< state before the last one */
+}GOERTZEL;
+
+/** @brief Turn raw ADC samples into FFT input
+ *
+ * Subtracts the mean of the block and shifts the samples up by 5 bits, so a
+ * 10 bit input uses the Q15 range. imag[] is cleared.
+ * @param raw 2^log2_points right adjusted samples
+ * @param real FFT input, may be the same memory as raw
+ * @param imag FFT input, 2^log2_points entries
+ * @param log2_points 6 for 64 points, 7 for 128 points
+ */
+void SpectrumPrepare(const uint16_t *raw, int16_t *real, int16_t *imag, uint8_t log2_points);
+
+/** @brief Radix-2 decimation in time FFT in place
+ * @param real Real part of the input and the output
+ * @param imag Imaginary part of the input and the output
+ * @param log2_points 1 up to SPECTRUM_LOG2_MAX_POINTS
+ * @return false if log2_points is out of range
+ */
+bool SpectrumFft(int16_t *real, int16_t *imag, uint8_t log2_points);
+
+/** @brief Magnitude of the first count bins
+ *
+ * Uses max + min / 2 of the absolute real and imaginary parts in place of
+ * the square root, which is within about 12 percent of the true magnitude.
+ * @param real FFT output, overwritten with the magnitudes
+ * @param imag FFT output
+ * @param count Number of bins, usually half the FFT points
+ */
+void SpectrumMagnitude(int16_t *real, const int16_t *imag, uint8_t count);
+
+/** @brief Find the biggest bin, skipping bin 0 (DC)
+ * @param magnitude Output of SpectrumMagnitude()
+ * @param count Number of bins
+ * @return the index of the biggest bin
+ */
+uint8_t SpectrumPeak(const int16_t *magnitude, uint8_t count);
+
+/** @brief Set up a Goertzel detector for one bin of a block of 2^log2_points
+ * samples
+ * @param bin The bin to detect, frequency is bin * sample_rate / points
+ * @param log2_points Block length as power of two (up to SPECTRUM_LOG2_MAX_POINTS)
+ */
+void GoertzelInit(GOERTZEL *detector, uint8_t bin, uint8_t log2_points);
+
+/** @brief Feed one sample into the detector
+ * @param sample Sample with the DC part removed
+ */
+void GoertzelUpdate(GOERTZEL *detector, int16_t sample);
+
+/** @brief Power in the bin after a full block, restarts the detector
+ * @return the squared magnitude divided by 2^(2 * GOERTZEL_POWER_SHIFT)
+ */
+uint32_t GoertzelPower(GOERTZEL *detector);
+
+#endif
@@ -0,0 +1,284 @@
+/*
+ * File : softtimer.c
+ *
+ * Description:
+ * File contains the necessary functions for software timers kept in a
+ * hashed timer wheel on the millisecond clock of timer.c
+ *
+ * Note:
+ * For detail documentation about the working and the use of the soft timers
+ * refer the header file softtimer.h
+ * Refer to E:/Avrprojects/library/coding standards.doc for coding standards
+ *
+ */
+
+#include <stddef.h>
+#include "timer.h"
+#include "softtimer.h"
+
+/* The soft timers run on the system clock, without it there is nothing to
+   build and the TIMER directory compiles as it is */
+#if TIMER_SYSTEM_CLOCK
+
+#if (SOFTTIMER_WHEEL_SIZE & (SOFTTIMER_WHEEL_SIZE - 1)) || (SOFTTIMER_WHEEL_SIZE > 256)
+#error "SOFTTIMER_WHEEL_SIZE has to be a power of two not more than 256"
+#endif
+#if (SOFTTIMER_POOL_SIZE < 1) || (SOFTTIMER_POOL_SIZE >= SOFTTIMER_NONE)
+#error "SOFTTIMER_POOL_SIZE has to be from 1 to 254"
+#endif
+
+#define SOFTTIMER_WHEEL_MASK (SOFTTIMER_WHEEL_SIZE - 1)
+/* SOFTTIMER_NONE from a failed SoftTimerCreate() is ignored by the functions
+   taking a timer */
+#define softtimer_valid(timer) ((timer) < SOFTTIMER_POOL_SIZE)
+#define softtimer_slot(expiry) ((uint8_t)(expiry) & SOFTTIMER_WHEEL_MASK)
+
+/* Where a timer of the pool is */
+typedef enum softtimer_state
+{
+    SOFTTIMER_FREE,     /* In the free list */
+    SOFTTIMER_IDLE,     /* Created, not running, in no list */
+    SOFTTIMER_RUNNING,  /* In the wheel slot of its expiry */
+    SOFTTIMER_PENDING   /* Expired, in the pending list waiting for its callback */
+}SOFTTIMER_STATE;
+
+typedef struct
+{
+    uint32_t expiry;
+    uint32_t period;
+    SOFTTIMER_CALLBACK callback;
+    void *context;
+    uint8_t next;
+    uint8_t prev;
+    uint8_t state;
+}SOFTTIMER_ENTRY;
+
+/* The lists link the timers by their index in the pool, SOFTTIMER_NONE
+ * ends a list. The free list only uses next */
+static SOFTTIMER_ENTRY softtimer_pool[SOFTTIMER_POOL_SIZE];
+static uint8_t softtimer_wheel[SOFTTIMER_WHEEL_SIZE];
+static uint8_t softtimer_pending;
+static uint8_t softtimer_free;
+
+/* Last millisecond whose slot has been handled */
+static uint32_t softtimer_now;
+
+/*
+ * Function: softtimer_head()
+ *
+ * Description: Finds the list a running or pending timer is in
+ *
+ * Returns: Pointer to the head of the list
+ */
+static uint8_t *softtimer_head(SOFTTIMER timer)
+{
+    if (softtimer_pool[timer].state == SOFTTIMER_PENDING)
+    {
+        return &softtimer_pending;
+    }
+    return &softtimer_wheel[softtimer_slot(softtimer_pool[timer].expiry)];
+}
+
+/*
+ * Function: softtimer_link()
+ *
+ * Description: Puts the timer in front of the list
+ *
+ * Returns: Nothing
+ */
+static void softtimer_link(SOFTTIMER timer, uint8_t *head)
+{
+    softtimer_pool[timer].prev = SOFTTIMER_NONE;
+    softtimer_pool[timer].next = *head;
+    if (*head != SOFTTIMER_NONE)
+    {
+        softtimer_pool[*head].prev = timer;
+    }
+    *head = timer;
+}
+
+/*
+ * Function: softtimer_unlink()
+ *
+ * Description: Takes a running or pending timer out of its list and leaves
+ * it idle, other timers are left alone
+ *
+ * Returns: Nothing
+ */
+static void softtimer_unlink(SOFTTIMER timer)
+{
+    SOFTTIMER_ENTRY *entry = &softtimer_pool[timer];
+
+    if ((entry->state != SOFTTIMER_RUNNING) && (entry->state != SOFTTIMER_PENDING))
+    {
+        return;
+    }
+    if (entry->prev != SOFTTIMER_NONE)
+    {
+        softtimer_pool[entry->prev].next = entry->next;
+    }
+    else
+    {
+        *softtimer_head(timer) = entry->next;
+    }
+    if (entry->next != SOFTTIMER_NONE)
+    {
+        softtimer_pool[entry->next].prev = entry->prev;
+    }
+    entry->state = SOFTTIMER_IDLE;
+}
+
+/*
+ * Function: softtimer_arm()
+ *
+ * Description: Hangs an idle timer in the wheel slot of its expiry
+ *
+ * Returns: Nothing
+ */
+static void softtimer_arm(SOFTTIMER timer)
+{
+    softtimer_pool[timer].state = SOFTTIMER_RUNNING;
+    softtimer_link(timer, &softtimer_wheel[softtimer_slot(softtimer_pool[timer].expiry)]);
+}
+
+void SoftTimerInit()
+{
+    uint8_t i;
+
+    for (i = 0; i < SOFTTIMER_WHEEL_SIZE; i++)
+    {
+        softtimer_wheel[i] = SOFTTIMER_NONE;
+    }
+    for (i = 0; i < SOFTTIMER_POOL_SIZE; i++)
+    {
+        softtimer_pool[i].state = SOFTTIMER_FREE;
+        softtimer_pool[i].next = i + 1;
+    }
+    softtimer_pool[SOFTTIMER_POOL_SIZE - 1].next = SOFTTIMER_NONE;
+    softtimer_free = 0;
+    softtimer_pending = SOFTTIMER_NONE;
+    softtimer_now = TimerMillis();
+}
+
+SOFTTIMER SoftTimerCreate(SOFTTIMER_CALLBACK callback, void *context)
+{
+    SOFTTIMER timer = softtimer_free;
+
+    if (timer != SOFTTIMER_NONE)
+    {
+        softtimer_free = softtimer_pool[timer].next;
+        softtimer_pool[timer].callback = callback;
+        softtimer_pool[timer].context = context;
+        softtimer_pool[timer].state = SOFTTIMER_IDLE;
+    }
+    return timer;
+}
+
+void SoftTimerDelete(SOFTTIMER timer)
+{
+    if (!softtimer_valid(timer) || (softtimer_pool[timer].state == SOFTTIMER_FREE))
+    {
+        return;
+    }
+    softtimer_unlink(timer);
+    softtimer_pool[timer].state = SOFTTIMER_FREE;
+    softtimer_pool[timer].next = softtimer_free;
+    softtimer_free = timer;
+}
+
+/*
+ * Function: SoftTimerStart()
+ *
+ * Description: Sets the expiry from the clock and puts the timer in its
+ * slot, a deleted timer or SOFTTIMER_NONE is not started. An expiry not
+ * after the last handled millisecond (delay 0, or a main loop that is
+ * behind) is moved to the next one so it is not missed
+ *
+ * Returns: Nothing
+ */
+void SoftTimerStart(SOFTTIMER timer, uint32_t delay, uint32_t period)
+{
+    uint32_t expiry = TimerMillis() + delay;
+
+    if (!softtimer_valid(timer) || (softtimer_pool[timer].state == SOFTTIMER_FREE))
+    {
+        return;
+    }
+    if ((int32_t)(expiry - softtimer_now) <= 0)
+    {
+        expiry = softtimer_now + 1;
+    }
+    softtimer_unlink(timer);
+    softtimer_pool[timer].expiry = expiry;
+    softtimer_pool[timer].period = period;
+    softtimer_arm(timer);
+}
+
+void SoftTimerStop(SOFTTIMER timer)
+{
+    if (softtimer_valid(timer))
+    {
+        softtimer_unlink(timer);
+    }
+}
+
+bool SoftTimerIsRunning(SOFTTIMER timer)
+{
+    if (!softtimer_valid(timer))
+    {
+        return false;
+    }
+    return (softtimer_pool[timer].state == SOFTTIMER_RUNNING) ||
+           (softtimer_pool[timer].state == SOFTTIMER_PENDING);
+}
+
+/*
+ * Function: SoftTimerService()
+ *
+ * Description: Steps through the milliseconds passed since the last call.
+ * The timers of a slot expiring in that millisecond are first moved to the
+ * pending list, the others are for a later turn of the wheel. Then the
+ * pending timers are taken one at a time, periodic ones go back into the
+ * wheel before the callback runs so it can stop or restart them, and a
+ * callback stopping another pending timer takes it off the pending list
+ *
+ * Returns: Nothing
+ */
+void SoftTimerService()
+{
+    uint32_t now = TimerMillis();
+    SOFTTIMER_ENTRY *entry;
+    SOFTTIMER timer;
+    SOFTTIMER next;
+
+    while (softtimer_now != now)
+    {
+        softtimer_now++;
+
+        for (timer = softtimer_wheel[softtimer_slot(softtimer_now)]; timer != SOFTTIMER_NONE; timer = next)
+        {
+            next = softtimer_pool[timer].next;
+            if (softtimer_pool[timer].expiry == softtimer_now)
+            {
+                softtimer_unlink(timer);
+                softtimer_pool[timer].state = SOFTTIMER_PENDING;
+                softtimer_link(timer, &softtimer_pending);
+            }
+        }
+
+        while (softtimer_pending != SOFTTIMER_NONE)
+        {
+            timer = softtimer_pending;
+            entry = &softtimer_pool[timer];
+            softtimer_unlink(timer);
+            if (entry->period)
+            {
+                entry->expiry += entry->period;
+                softtimer_arm(timer);
+            }
+            entry->callback(entry->context);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,121 @@
+/************************************************************************
+ * Name : softtimer.h
+ *
+ * Header file for the softtimer.c file
+ *
+ * Contains the macros, types and function definitions for software timers
+ * on the millisecond clock of timer.c (TIMER_SYSTEM_CLOCK). The timers are
+ * kept in a hashed timer wheel: SOFTTIMER_WHEEL_SIZE slots, one per
+ * millisecond, a timer hangs in the slot of its expiry time modulo the
+ * wheel size. Start, stop and expiry are O(1), a tick only looks at the
+ * timers of one slot whatever the number of running timers.
+ ************************************************************************/
+/************
+Usage
+
+	static void BlinkLed(void *context) { TogglePin(...); }
+	static void ReadSensor(void *context) { ... }
+
+	SOFTTIMER blink, sensor;
+
+	TimerInit();
+	SoftTimerInit();
+	blink = SoftTimerCreate(BlinkLed, NULL);
+	sensor = SoftTimerCreate(ReadSensor, NULL);
+	SoftTimerStart(blink, 500, 500);    // every 500 ms
+	SoftTimerStart(sensor, 20, 0);      // once in 20 ms
+	sei();
+	for (;;)
+	{
+		SoftTimerService();
+		...
+	}
+
+	The callbacks run from SoftTimerService() in the main loop, not from the
+	interrupt, and may start, stop and delete any timer including their own.
+	Timers expiring in the same millisecond are called in the order they
+	were started. Functions given SOFTTIMER_NONE (pool used up) do nothing.
+	A main loop that falls behind gets every expiry late but none is lost,
+	periodic timers keep their phase.
+*************/
+
+#ifndef _SOFTTIMER_H_
+#define _SOFTTIMER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Number of timers that can be created, at most 254. Each takes 15 bytes */
+#define SOFTTIMER_POOL_SIZE 32
+/* Slots of the wheel, has to be a power of two. Timers further away than
+ * the wheel size stay in their slot for more turns, make it a bit more
+ * than the most used period */
+#define SOFTTIMER_WHEEL_SIZE 64
+
+/* Handle of a timer, SOFTTIMER_NONE when the pool is used up. Passing
+ * SOFTTIMER_NONE on is safe, the timer functions ignore it */
+typedef uint8_t SOFTTIMER;
+#define SOFTTIMER_NONE 0xFF
+
+typedef void (*SOFTTIMER_CALLBACK)(void *context);
+
+/* The module is only built with TIMER_SYSTEM_CLOCK set in timerconfig.h,
+ * otherwise softtimer.c compiles to nothing */
+
+/** @brief Empties the pool and the wheel
+ *
+ * The system clock has to be started with TimerInit().
+ * @param void accepts nothing
+ * @return returns nothing
+ */
+void SoftTimerInit();
+
+/** @brief Takes a timer from the pool
+ *
+ * @param callback Function called when the timer expires
+ * @param context Passed on to the callback
+ * @return the timer, SOFTTIMER_NONE if the pool is used up
+ */
+SOFTTIMER SoftTimerCreate(SOFTTIMER_CALLBACK callback, void *context);
+
+/** @brief Stops the timer and gives it back to the pool
+ *
+ * @param timer The timer, it must not be used afterwards
+ * @return returns nothing
+ */
+void SoftTimerDelete(SOFTTIMER timer);
+
+/** @brief Starts or restarts a timer
+ *
+ * @param timer The timer
+ * @param delay Milliseconds to the first expiry, 0 expires on the next tick
+ * @param period Milliseconds between the following expiries, 0 for a one
+ * shot timer
+ * @return returns nothing
+ */
+void SoftTimerStart(SOFTTIMER timer, uint32_t delay, uint32_t period);
+
+/** @brief Stops a timer, a pending expiry is cancelled
+ *
+ * @param timer The timer
+ * @return returns nothing
+ */
+void SoftTimerStop(SOFTTIMER timer);
+
+/** @brief Tells if a timer is going to expire
+ *
+ * @param timer The timer
+ * @return true if started and not expired (one shot) or stopped
+ */
+bool SoftTimerIsRunning(SOFTTIMER timer);
+
+/** @brief Runs the callbacks of the timers expired since the last call
+ *
+ * Call it from the main loop as often as possible. None of the soft timer
+ * functions may be called from an interrupt.
+ * @param void accepts nothing
+ * @return returns nothing
+ */
+void SoftTimerService();
+
+#endif
@@ -21,162 +21,181 @@
 */
 
 #include <inttypes.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
 #include "timer.h"
 
-/* This function should be static here */
-void timer_setup_all(TIMER timer)
+#if TIMER_SYSTEM_CLOCK
+/* Timer 0 ticks to microseconds, a multiply whenever a tick is a whole
+   number of microseconds (all the usual crystals) */
+#if (1000 % TIMER_TICKS_PER_MS) == 0
+#define timer_ticks_to_micros(ticks) ((uint16_t)(ticks) * (uint16_t)(1000 / TIMER_TICKS_PER_MS))
+#else
+#define timer_ticks_to_micros(ticks) ((uint16_t)(((uint32_t)(ticks) * 1000) / TIMER_TICKS_PER_MS))
+#endif
+
+/* Milliseconds since TimerInit(), only written by the compare ISR */
+static volatile uint32_t timer_millis;
+
+/*
+ * Function: ISR(TIMER0_COMP_vect)
+ *
+ * Description: Timer 0 compare match, once every millisecond
+ *
+ * Returns: Nothing
+ */
+ISR(TIMER0_COMP_vect)
+{
+    timer_millis++;
+}
+
+/*
+ * Function: TimerMillis()
+ *
+ * Description: Reads the millisecond count, the four bytes with the
+ * interrupts off so the ISR can not change it half way
+ *
+ * Returns: The milliseconds since TimerInit()
+ */
+uint32_t TimerMillis()
+{
+    uint32_t millis;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        millis = timer_millis;
+    }
+    return millis;
+}
+
+/*
+ * Function: TimerMicros()
+ *
+ * Description: Reads the millisecond count and TCNT0 together. With the
+ * interrupts off (or when called from an ISR) a compare match can be pending
+ * with TCNT0 already cleared and the millisecond not counted yet, OCF0 tells
+ * so. TCNT0 is read before OCF0, a match between the two reads leaves TCNT0
+ * near TOP and must not be counted twice
+ *
+ * Returns: The microseconds since TimerInit()
+ */
+uint32_t TimerMicros()
 {
-    uint8_t val = 0;
-    uint8_t mode = 0;
-    uint8_t OC0_mode = 0;
-    switch(timer)
+    uint32_t millis;
+    uint8_t ticks;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        millis = timer_millis;
+        ticks = TCNT0;
+        if ((TIFR & (1 << OCF0)) && (ticks < (TIMER_TICKS_PER_MS / 2)))
+        {
+            millis++;
+        }
+    }
+    return (millis * 1000) + timer_ticks_to_micros(ticks);
+}
+#endif
+
+/*
+ * Function: Timer1Read16()
+ *
+ * Description: Reads a 16 bit timer 1 register. The low byte has to be read
+ * first, it latches the high byte into TEMP
+ *
+ * Returns: The register value
+ */
+uint16_t Timer1Read16(volatile uint16_t *reg)
+{
+    uint16_t value;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        value = *reg;
+    }
+    return value;
+}
+
+/*
+ * Function: Timer1Write16()
+ *
+ * Description: Writes a 16 bit timer 1 register, the high byte first
+ *
+ * Returns: Nothing
+ */
+void Timer1Write16(volatile uint16_t *reg, uint16_t value)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        *reg = value;
+    }
+}
+
+/*
+ * Function: TimerInit()
+ *
+ * Description: Loads the registers of the timers activated in timerconfig.h.
+ * All values are constants worked out from the configuration by the
+ * compiler, the timers are left stopped. Starts the system clock on timer 0
+ * when TIMER_SYSTEM_CLOCK is set
+ *
+ * Returns: Nothing
+ */
+void TimerInit()
+{
+#if TIMER0_ACTIVATED
+    TCCR0 = TIMER0_TCCR_VALUE;
+    TCNT0 = 0;
+    OCR0 = TIMER0_COMPARE;
+#endif
+
+#if TIMER_SYSTEM_CLOCK
+    /* Timer 0 in CTC mode clears every TIMER_TICKS_PER_MS ticks and is left
+       running, the clock counts as soon as the interrupts are enabled */
+    TCCR0 = 0;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        timer_millis = 0;
+        TCNT0 = 0;
+        OCR0 = TIMER_TICKS_PER_MS - 1;
+        TIFR = (1 << OCF0);
+        TIMSK |= (1 << OCIE0);
+    }
+    TCCR0 = (1 << WGM01) | TIMER_SYSTEM_PRESCALE;
+#endif
+
+#if TIMER1_ACTIVATED
+    /* Timer stopped and the mode set before TOP and the compare values, the
+       16 bit registers are written with the interrupts off */
+    TCCR1B = 0;
+    TCCR1A = TIMER1_TCCRA_VALUE;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        TCNT1 = 0;
+        if (Timer1TopInIcr1(TIMER1_MODE))
+        {
+            ICR1 = TIMER1_TOP;
+        }
+        OCR1A = TIMER1_OCR1A_VALUE;
+        OCR1B = TIMER1_COMPARE_B;
+    }
+    TCCR1B = TIMER1_TCCRB_VALUE;
+#endif
+
+#if TIMER2_ACTIVATED
+    TCCR2 = TIMER2_TCCR_VALUE;
+    TCNT2 = 0;
+    OCR2 = TIMER2_COMPARE;
+#endif
+
+    /* TIMSK is shared with the other modules. The interrupt flags are enums
+       and can not be tested with #if, the compiler drops this if there are
+       none */
+    if (TIMER_TIMSK_VALUE)
     {
-        /* set up timer 0 registers */	 
-        /* the registers to be used are 
-        1) tccro - > to set the cpu clock, timer mode of operation, timer mode of operation 
-        2) tcnto -> counter whcih increments decrements every clock tick 
-        3) ocr0 - > ouptu comapre reigster to be set in different modes of operation 
-        4) timsk -> to be set for interrupts 
-        5) tifr -> interrupt flag register.. the bits are set when some condition occurs whcih triggers interupt 
-        6) sfior special function io register 
-        */
-        /* 
-        INFO: the ways to reduce this huge line of code is to haev the enums with the ored expression for each mode 
-        and tehn we can just see the enum abd assign teh value.. This is now implemented
-        */
-        case TIMER_0_8_BITS:
-            mode = timer_setup[TIMER_0_8_BITS].timer_mode;
-            if (mode == NORMAL)
-            {
-                val |=  ((0 << WGM01) | (0 << WGM00) );
-                OC0_mode = timer_setup[TIMER_0_8_BITS].OC_mode;
-                val |= OC0_mode;
-                
-            }
-            else if( mode == PWM_PHASE_CORRECT)
-            {
-                val |= ((0 << WGM01)| (1 << WGM00) );
-                OC0_mode = timer_setup[TIMER_0_8_BITS].OC_mode;
-                val |= OC0_mode;
-            }
-            else if( mode == CLEAR_TIMER_ON_COMPARE_MATCH)
-            {
-                val |=  ((1 << WGM01)| (0 << WGM00) );
-                OC0_mode = timer_setup[TIMER_0_8_BITS].OC_mode;
-                val |= OC0_mode;
-            }
-            else if( mode == FAST_PWM)
-            {
-                val |= ((1 << WGM01)| (1 << WGM00)) ;
-                OC0_mode = timer_setup[TIMER_0_8_BITS].OC_mode;
-                val |= OC0_mode;
-            }  
-            else
-            {
-                /* specify some error here*/
-            }   
-            
-            /* Set the interrupt type set by the user */
-            if (timer_setup[TIMER_0_8_BITS].interrupt_enabled == true) 
-            {
-                if (timer_setup[TIMER_0_8_BITS].type_of_interrupt & TIMER_0_8_BITS_OUTPUT_COMPARE_MATCH)
-                {
-                    SetIntOvflT0();
-                }
-                if(timer_setup[TIMER_0_8_BITS].type_of_interrupt & TIMER_0_8_BITS_OVERFLOW)
-                {
-                    SetIntCompMatchT0();
-                }
-            }
-            else
-            {
-                /* specify error here*/
-            } 
-			/* Finally setup the timer counter control register */
-			SetTCCR0(val);			
-        break;
-        
-        /* set up timer 1 registers */
-        case TIMER_1_16_BITS :
-        break;
-        
-        /* set up timer 2 registers */
-		/* NOTE :
-		        The asynchronous operation is not yet implemented and needs implementing 
-		 */
-        case TIMER_2_8_BITS :
-		    mode = timer_setup[TIMER_2_8_BITS].timer_mode;
-		    if (mode == NORMAL)
-		    {
-			    val |=  ((0 << WGM21)| (0 << WGM20));
-                OC0_mode = timer_setup[TIMER_2_8_BITS].OC_mode;
-				val |= OC0_mode;
-		    }
-		    else if( mode == PWM_PHASE_CORRECT)
-		    {
-			    val |= ((0 << WGM21)| (1 << WGM20) );
-				OC0_mode = timer_setup[TIMER_2_8_BITS].OC_mode;
-				val |= OC0_mode;
-		    }
-		    else if( mode == CLEAR_TIMER_ON_COMPARE_MATCH)
-		    {
-			    val |= ((1 << WGM21)| (0 << WGM20));
-				OC0_mode = timer_setup[TIMER_2_8_BITS].OC_mode;
-				val |= OC0_mode;
-		    }
-		    else if( mode == FAST_PWM)
-		    {
-			    val |= ((1 << WGM21)| (1 << WGM20));
-				OC0_mode = timer_setup[TIMER_2_8_BITS].OC_mode;
-				val |= OC0_mode;			    
-		    }
-		    else
-		    {
-			    /* specify some error here*/
-		    }
-		            
-		    /* Set the interrupt type set by the user */
-		    if (timer_setup[TIMER_2_8_BITS].interrupt_enabled == true)
-		    {
-			    if (timer_setup[TIMER_2_8_BITS].type_of_interrupt & TIMER_2_8_BITS_OUTPUT_COMPARE_MATCH)
-			    {
-				    SetIntOvflT2();
-			    }
-			    if (timer_setup[TIMER_2_8_BITS].type_of_interrupt & TIMER_2_8_BITS_OVERFLOW)
-			    {
-				    SetIntCompMatchT2();
-			    }
-		    }
-		    else
-		    {
-			    /* specify error here*/
-		    }
-		    /* Finally setup the timer counter control register */
-		    SetTCCR2(val);
-        break;
-
-        /* just to avoid any warnings*/
-        default:        
-        break;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            TIMSK |= TIMER_TIMSK_VALUE;
+        }
     }
-  }
-  
-
-  /* Implementation Note timer init can tak ien the use defien d function pointer for differnt inerruprs may be */
-
-  void TimerInit()
-  {
-	  uint8_t i;
-
-	  for (i = 0; i < NO_OF_TIMERS; i++)
-	  {
-		  if(timer_setup[i].activated == true)
-		  { 
-			  timer_setup_all(timer_setup[i].timer);
-		  }
-		  else
-		  {
-			  continue;
-		  }
-	  }
-  }
+}
@@ -39,6 +39,7 @@ ALL ENUMS CAN BE PREFIXED WITHE THE IDENTIFIER TIMER0 WHEN IMPLEMTATION STARTS F
 
 #include <avr/io.h>
 #include <stdbool.h>
+#include <stdint.h>
 /*-------------
  * HASHDEFINES
  --------------*/
@@ -85,6 +86,45 @@ typedef enum oc_pin_mode
 	PHASE_CORRECT_PWM_SET_ON_COMPARE_MATCH_CLEAR_AT_BOTTOM = (1 << COM01) | (1 << COM00)
 }OC_PIN_MODE;
 
+/** Waveform generation modes of the 16 bit timer 1, the values are the
+ WGM13:0 bits. TOP is the counter value the timer counts up to */
+typedef enum timer1_modes
+{
+    TIMER1_NORMAL = 0,                           /**< TOP 0xFFFF */
+    TIMER1_PWM_PHASE_CORRECT_8_BITS = 1,         /**< TOP 0x00FF */
+    TIMER1_PWM_PHASE_CORRECT_9_BITS = 2,         /**< TOP 0x01FF */
+    TIMER1_PWM_PHASE_CORRECT_10_BITS = 3,        /**< TOP 0x03FF */
+    TIMER1_CTC_TOP_OCR1A = 4,                    /**< TOP OCR1A */
+    TIMER1_FAST_PWM_8_BITS = 5,                  /**< TOP 0x00FF */
+    TIMER1_FAST_PWM_9_BITS = 6,                  /**< TOP 0x01FF */
+    TIMER1_FAST_PWM_10_BITS = 7,                 /**< TOP 0x03FF */
+    TIMER1_PWM_PHASE_FREQ_CORRECT_TOP_ICR1 = 8,  /**< TOP ICR1 */
+    TIMER1_PWM_PHASE_FREQ_CORRECT_TOP_OCR1A = 9, /**< TOP OCR1A, OC1A only toggles */
+    TIMER1_PWM_PHASE_CORRECT_TOP_ICR1 = 10,      /**< TOP ICR1 */
+    TIMER1_PWM_PHASE_CORRECT_TOP_OCR1A = 11,     /**< TOP OCR1A, OC1A only toggles */
+    TIMER1_CTC_TOP_ICR1 = 12,                    /**< TOP ICR1 */
+    /* 13 is reserved */
+    TIMER1_FAST_PWM_TOP_ICR1 = 14,               /**< TOP ICR1 */
+    TIMER1_FAST_PWM_TOP_OCR1A = 15               /**< TOP OCR1A, OC1A only toggles */
+}TIMER1_MODES;
+
+/** Behaviour of the OC1A and OC1B pins, the values are the COM1x1:0 bits.
+ In the PWM modes CLEAR is the non inverted and SET the inverted output */
+typedef enum timer1_oc_mode
+{
+    TIMER1_OC_DISCONNECTED = 0,
+    TIMER1_OC_TOGGLE_ON_COMPARE_MATCH = 1,
+    TIMER1_OC_CLEAR_ON_COMPARE_MATCH = 2,
+    TIMER1_OC_SET_ON_COMPARE_MATCH = 3
+}TIMER1_OC_MODE;
+
+/** Edge of the ICP1 pin the input capture unit triggers on */
+typedef enum timer1_capture_edge
+{
+    TIMER1_CAPTURE_FALLING_EDGE,
+    TIMER1_CAPTURE_RISING_EDGE
+}TIMER1_CAPTURE_EDGE;
+
 typedef enum cpu_clk_prescale
 {
     NO_CLK_SRC,
@@ -110,88 +150,154 @@ typedef enum interrupt_type
 }INTERRUPT_TYPE;	
 
 /*
- * STRUCTURES
+ * CONFIGURATION
 -*/
-/*! the user needs to populate this structure and then just call TimerInit in the main routine which will just initialize the timer based on the information in the structure. However the timer will not be started until the user wishes and hence he needs to call start timer
-with the time specified int eh function macro which will then set the clock and start the timer based on the information provided in this structure
+/*! The timers are set up in timerconfig.h. Everything TimerInit() writes to
+the registers is worked out from it by the macros below at compile time, so
+there is no setup structure in SRAM and no decision left to be made at run
+time. The timer will not be started until the user wishes and hence he needs
+to call the StartTimerN() macro, which sets the clock select bits with the
+configured prescale
 */
-typedef struct timer_stp
-{
-	TIMER timer; /**< identifies which timer to use */
-	bool activated; /**< set to true if you wish to use the timer else false*/
-	TIMER_MODES timer_mode; /**< mode in which the timer should operate ..pwm,ctc,icmp etc etc..*/
-	OC_PIN_MODE OC_mode; /**< set the behavior for the OC pin if connected */
-	CPU_CLK_PRESCALE cpu_clk_prescale; /**< CPU clock to be used */
-	bool interrupt_enabled; /**< whether interrupts should be set for this timer*/
-	INTERRUPT_TYPE type_of_interrupt; /**< Type fo fhte interrupt */
-}TIMER_SETUP;
+#include "timerconfig.h"
+
+/* WGM bits of the 8 bit timers for the TIMER_MODES, n is the timer number */
+#define TimerModeBits(n,mode) \
+	(((mode) == CLEAR_TIMER_ON_COMPARE_MATCH) ? (1 << WGM##n##1) : \
+	 ((mode) == PWM_PHASE_CORRECT) ? (1 << WGM##n##0) : \
+	 ((mode) == FAST_PWM) ? ((1 << WGM##n##1) | (1 << WGM##n##0)) : 0)
 
-TIMER_SETUP timer_setup[NO_OF_TIMERS];
+/* TIMSK bits for the INTERRUPT_TYPE flags */
+#define TimerInterruptBits(flags) \
+	((((flags) & TIMER_0_8_BITS_OVERFLOW) ? (1 << TOIE0) : 0) | \
+	 (((flags) & TIMER_0_8_BITS_OUTPUT_COMPARE_MATCH) ? (1 << OCIE0) : 0) | \
+	 (((flags) & TIMER_1_16_BITS_OVERFLOW) ? (1 << TOIE1) : 0) | \
+	 (((flags) & TIMER_1_16_BITS_1B_OUTPUT_COMPARE_MATCH) ? (1 << OCIE1B) : 0) | \
+	 (((flags) & TIMER_1_16_BITS_1A_OUTPUT_COMPARE_MATCH) ? (1 << OCIE1A) : 0) | \
+	 (((flags) & TIMER_1_16_BITS_INPUT_COMPARE) ? (1 << TICIE1) : 0) | \
+	 (((flags) & TIMER_2_8_BITS_OVERFLOW) ? (1 << TOIE2) : 0) | \
+	 (((flags) & TIMER_2_8_BITS_OUTPUT_COMPARE_MATCH) ? (1 << OCIE2) : 0))
+
+/* Timer 1 modes with TOP in ICR1 and in OCR1A */
+#define Timer1TopInIcr1(mode) (((mode) == TIMER1_PWM_PHASE_FREQ_CORRECT_TOP_ICR1) || \
+                               ((mode) == TIMER1_PWM_PHASE_CORRECT_TOP_ICR1) || \
+                               ((mode) == TIMER1_CTC_TOP_ICR1) || \
+                               ((mode) == TIMER1_FAST_PWM_TOP_ICR1))
+#define Timer1TopInOcr1a(mode) (((mode) == TIMER1_CTC_TOP_OCR1A) || \
+                                ((mode) == TIMER1_PWM_PHASE_FREQ_CORRECT_TOP_OCR1A) || \
+                                ((mode) == TIMER1_PWM_PHASE_CORRECT_TOP_OCR1A) || \
+                                ((mode) == TIMER1_FAST_PWM_TOP_OCR1A))
+
+/* Register values, the timers are loaded stopped (no clock select bits) */
+#define TIMER0_TCCR_VALUE (TimerModeBits(0, TIMER0_MODE) | (TIMER0_OC_MODE))
+#define TIMER2_TCCR_VALUE (TimerModeBits(2, TIMER2_MODE) | (TIMER2_OC_MODE))
+#define TIMER1_TCCRA_VALUE (((TIMER1_OC1A_MODE) << COM1A0) | ((TIMER1_OC1B_MODE) << COM1B0) | \
+                            (((TIMER1_MODE) & 0x03) << WGM10))
+#define TIMER1_TCCRB_VALUE ((((TIMER1_MODE) >> 2) << WGM12) | \
+                            ((TIMER1_NOISE_CANCELER) ? (1 << ICNC1) : 0) | \
+                            (((TIMER1_CAPTURE_EDGE) == TIMER1_CAPTURE_RISING_EDGE) ? (1 << ICES1) : 0))
+#define TIMER1_OCR1A_VALUE (Timer1TopInOcr1a(TIMER1_MODE) ? (TIMER1_TOP) : (TIMER1_COMPARE_A))
+#define TIMER_TIMSK_VALUE \
+	(((TIMER0_ACTIVATED) ? TimerInterruptBits(TIMER0_INTERRUPTS) : 0) | \
+	 ((TIMER1_ACTIVATED) ? TimerInterruptBits(TIMER1_INTERRUPTS) : 0) | \
+	 ((TIMER2_ACTIVATED) ? TimerInterruptBits(TIMER2_INTERRUPTS) : 0))
+
+/* System clock on timer 0. The timer counts TIMER_TICKS_PER_MS ticks per
+ millisecond in CTC mode, the lowest prescale giving a whole number of ticks
+ is taken for the best TimerMicros() resolution */
+#if TIMER_SYSTEM_CLOCK
+#if TIMER0_ACTIVATED
+#error "Timer 0 runs the system clock, set TIMER0_ACTIVATED or TIMER_SYSTEM_CLOCK to 0"
+#endif
+#ifndef F_CPU
+#error "F_CPU has to be defined for the system clock"
+#elif ((F_CPU) % 8000UL == 0) && ((F_CPU) / 8000UL <= 256)
+#define TIMER_SYSTEM_PRESCALE CLK_DIV_8
+#define TIMER_TICKS_PER_MS ((F_CPU) / 8000UL)
+#elif ((F_CPU) % 64000UL == 0) && ((F_CPU) / 64000UL <= 256)
+#define TIMER_SYSTEM_PRESCALE CLK_DIV_64
+#define TIMER_TICKS_PER_MS ((F_CPU) / 64000UL)
+#elif ((F_CPU) % 256000UL == 0) && ((F_CPU) / 256000UL <= 256)
+#define TIMER_SYSTEM_PRESCALE CLK_DIV_256
+#define TIMER_TICKS_PER_MS ((F_CPU) / 256000UL)
+#else
+#error "F_CPU gives no whole number of timer 0 ticks per millisecond, set TIMER_SYSTEM_CLOCK to 0"
+#endif
+#endif
 
 /*--------
  * MACROS
  ---------*/
-/* TODO complete these macros*/
-#define FillTimer0Structure(tim,act,mode,OC,clk,int_en,int_type) do { \
-	   timer_setup[0].timer = (tim); \
-	   timer_setup[0].activated = (act); \
-	   timer_setup[0].timer_mode = (mode); \
-	   timer_setup[0].OC_mode = (OC); \
-	   timer_setup[0].cpu_clk_prescale = (clk); \
-	   timer_setup[0].interrupt_enabled = (int_en); \
-	   timer_setup[0].type_of_interrupt = (int_type); } while(0)
-	
-#define FillTimer1Structure(tim,act,mode,OC,clk,int_en,int_type) do { \
-	   timer_setup[1].timer = (tim); \
-	   timer_setup[1].activated = (act); \
-	   timer_setup[1].timer_mode = (mode); \
-	   timer_setup[1].OC_mode = (OC); \
-	   timer_setup[1].cpu_clk_prescale = (clk); \
-	   timer_setup[1].interrupt_enabled = (int_en); \
-	   timer_setup[1].type_of_interrupt = (int_type); } while(0)
-
-#define FillTimer2Structure(tim,act,mode,OC,clk,int_en,int_type) do { \
-	   timer_setup[2].timer = (tim); \
-	   timer_setup[2].activated = (act); \
-	   timer_setup[2].timer_mode = (mode); \
-	   timer_setup[2].OC_mode = (OC); \
-	   timer_setup[2].cpu_clk_prescale = (clk); \
-	   timer_setup[2].interrupt_enabled = (int_en); \
-	   timer_setup[2].type_of_interrupt = (int_type); } while(0)
-	
-#define SetIntOvflT0()  TIMSK |= 1 << TOIE0 /* set the TIMSK regs to the overflow interrupt */
-#define SetIntOvflT2()  TIMSK |= 1 << TOIE2
-#define SetIntCompMatchT0() TIMSK |= 1 << OCIE0/* set the TIMSK regs to the compare match interrupt with out distrubing the otherws so use or operaion */
-#define SetIntCompMatchT2() TIMSK |= 1 << OCIE2
-
-#define SetTCCR0(val) TCCR0 |= (val)/* set the TCCR0 register with the value passed in */ 
-#define SetTCCR2(val) TCCR2 |= (val)
-
-#define StartTimer0() TCCR0 |= timer_setup[TIMER_0_8_BITS].cpu_clk_prescale << CS00/* the timer has to be started with the selected cpu prescale */  
-#define StartTimer1()
-#define StartTimer2() TCCR2 |= timer_setup[TIMER_2_8_BITS].cpu_clk_prescale << CS20)/* the timer has to be started with the selected cpu prescale */  
-#define StopTimer0() TCCR0 |= 0 << CS00
-#define StopTimer1() 
-#define StopTimer2() TCCR2 |= 0 << CS20
-
-#define LoadTCNT() /* same macro for all timers ??*/
-#define LoadOCCR() /*same macro for all timers ??*/
+#define TIMER_CLOCK_SELECT_MASK 0x07
+
+/* Milliseconds passed since the time stamp t taken with TimerMillis(), right
+ across the 49 day wrap of the counter */
+#define TimerMillisSince(t) (TimerMillis() - (uint32_t)(t))
+
+#define StartTimer0() (TCCR0 = (TCCR0 & ~(TIMER_CLOCK_SELECT_MASK << CS00)) | ((TIMER0_PRESCALE) << CS00))/* the timer has to be started with the selected cpu prescale */  
+#define StartTimer1() (TCCR1B = (TCCR1B & ~(TIMER_CLOCK_SELECT_MASK << CS10)) | ((TIMER1_PRESCALE) << CS10))
+#define StartTimer2() (TCCR2 = (TCCR2 & ~(TIMER_CLOCK_SELECT_MASK << CS20)) | ((TIMER2_PRESCALE) << CS20))
+#define StopTimer0() (TCCR0 &= ~(TIMER_CLOCK_SELECT_MASK << CS00))
+#define StopTimer1() (TCCR1B &= ~(TIMER_CLOCK_SELECT_MASK << CS10))
+#define StopTimer2() (TCCR2 &= ~(TIMER_CLOCK_SELECT_MASK << CS20))
+
+/* Timer 1 16 bit registers, read and written through Timer1Read16() and
+ Timer1Write16() so an ISR using them can not get in between the two byte
+ accesses through the shared TEMP register */
+#define Timer1ReadCounter() Timer1Read16(&TCNT1)
+#define Timer1WriteCounter(val) Timer1Write16(&TCNT1, (val))
+#define Timer1ReadCapture() Timer1Read16(&ICR1)
+#define Timer1WriteCapture(val) Timer1Write16(&ICR1, (val))
+#define Timer1WriteCompareA(val) Timer1Write16(&OCR1A, (val))
+#define Timer1WriteCompareB(val) Timer1Write16(&OCR1B, (val))
 
 /*----------------------
  * FUNCTION DECLARATION 
  -----------------------*/
 /**
- This function initializes timer on atmega
+ This function initializes the timers activated in timerconfig.h, it is just
+ a few direct register stores of the values worked out at compile time. The
+ timers are left stopped, see StartTimerN()
  @param void accepts nothing
  @return returnds nothing 
 */
 void TimerInit();
 
 /**
- This function setsup the timer for teh timer passed in 
- @param timer the timer to setup
- @return returnds nothing 
+ Reads a 16 bit timer 1 register (TCNT1, ICR1, OCR1A, OCR1B) with the
+ interrupts off
+ @param reg the register, e.g. &ICR1
+ @return the register value
+*/
+uint16_t Timer1Read16(volatile uint16_t *reg);
+
+/**
+ Writes a 16 bit timer 1 register with the interrupts off, the high byte
+ goes to TEMP first as the datasheet asks for
+ @param reg the register, e.g. &OCR1A
+ @param value the value to write
+ @return returns nothing
 */
-void TimerSetupAll(TIMER timer);
+void Timer1Write16(volatile uint16_t *reg, uint16_t value);
+
+#if TIMER_SYSTEM_CLOCK
+/**
+ Milliseconds since TimerInit(), wraps after 49.7 days. Can be called from
+ the main loop and from an ISR, global interrupts have to be enabled for
+ the clock to run
+ @param void accepts nothing
+ @return the millisecond count
+*/
+uint32_t TimerMillis();
+
+/**
+ Microseconds since TimerInit(), made up of the millisecond count and TCNT0
+ so the resolution is one timer 0 tick (4 us at 16 MHz, 8 us at 8 MHz).
+ Wraps after 71.6 minutes. Can be called from the main loop and from an ISR
+ @param void accepts nothing
+ @return the microsecond count
+*/
+uint32_t TimerMicros();
+#endif
 
 #endif
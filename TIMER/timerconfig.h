@@ -0,0 +1,82 @@
+/************************************************************************
+ * Name : timerconfig.h 
+ * 
+ * Header file for the timer.c file
+ *  
+ * Contains the configuration of the three timers. change this file when
+ * needed to suit the application, TimerInit() then loads the registers
+ * with the values worked out from it at compile time.
+ * The enums used here are the ones in timer.h
+ ************************************************************************/
+#ifndef _TIMER_CONFIG_H_
+#define _TIMER_CONFIG_H_
+
+/*----------------------------------------------------------------------
+ * SYSTEM CLOCK
+ *  TIMER_SYSTEM_CLOCK : 1 to run the millisecond clock of TimerMillis() and
+ *                       TimerMicros() on timer 0 in CTC mode, needed by the
+ *                       soft timers and the scheduler. F_CPU has to give a
+ *                       whole number of ticks per millisecond (1, 8 or
+ *                       16 MHz, not 12 or 11.0592 MHz).
+ *                       Timer 0 is then taken: TIMER0_ACTIVATED has to be 0
+ *                       and the ADC stream must not use a timer 0 trigger,
+ *                       use TRIGGER_TIMER_1_COMPARE_MATCH_B
+ ----------------------------------------------------------------------*/
+#define TIMER_SYSTEM_CLOCK 0
+
+/*----------------------------------------------------------------------
+ * TIMER 0 (8 bits)
+ *  TIMER0_ACTIVATED  : 1 to set up the timer in TimerInit()
+ *  TIMER0_MODE       : TIMER_MODES
+ *  TIMER0_OC_MODE    : OC_PIN_MODE, behaviour of the OC0 pin
+ *  TIMER0_PRESCALE   : CPU_CLK_PRESCALE, used by StartTimer0()
+ *  TIMER0_INTERRUPTS : TIMER_0_8_BITS_... flags of INTERRUPT_TYPE or 0
+ *  TIMER0_COMPARE    : OCR0
+ ----------------------------------------------------------------------*/
+#define TIMER0_ACTIVATED 0
+#define TIMER0_MODE NORMAL
+#define TIMER0_OC_MODE NORMAL_CTC_NORMAL_DISCONNECTED
+#define TIMER0_PRESCALE CLK_DIV_64
+#define TIMER0_INTERRUPTS 0
+#define TIMER0_COMPARE 0
+
+/*----------------------------------------------------------------------
+ * TIMER 1 (16 bits)
+ *  TIMER1_ACTIVATED      : 1 to set up the timer in TimerInit()
+ *  TIMER1_MODE           : TIMER1_MODES, one of the 15 WGM modes
+ *  TIMER1_OC1A_MODE      : TIMER1_OC_MODE, behaviour of the OC1A pin
+ *  TIMER1_OC1B_MODE      : TIMER1_OC_MODE, behaviour of the OC1B pin
+ *  TIMER1_NOISE_CANCELER : 1 to filter the ICP1 input over 4 clocks
+ *  TIMER1_CAPTURE_EDGE   : TIMER1_CAPTURE_EDGE of ICP1
+ *  TIMER1_PRESCALE       : CPU_CLK_PRESCALE, used by StartTimer1()
+ *  TIMER1_INTERRUPTS     : TIMER_1_16_BITS_... flags of INTERRUPT_TYPE or 0
+ *  TIMER1_TOP            : TOP for the modes with TOP in ICR1 or OCR1A
+ *  TIMER1_COMPARE_A      : OCR1A, not used if OCR1A is TOP
+ *  TIMER1_COMPARE_B      : OCR1B
+ ----------------------------------------------------------------------*/
+#define TIMER1_ACTIVATED 0
+#define TIMER1_MODE TIMER1_NORMAL
+#define TIMER1_OC1A_MODE TIMER1_OC_DISCONNECTED
+#define TIMER1_OC1B_MODE TIMER1_OC_DISCONNECTED
+#define TIMER1_NOISE_CANCELER 0
+#define TIMER1_CAPTURE_EDGE TIMER1_CAPTURE_FALLING_EDGE
+#define TIMER1_PRESCALE CLK_DIV_8
+#define TIMER1_INTERRUPTS 0
+#define TIMER1_TOP 0xFFFF
+#define TIMER1_COMPARE_A 0
+#define TIMER1_COMPARE_B 0
+
+/*----------------------------------------------------------------------
+ * TIMER 2 (8 bits), the same settings as timer 0. Note that the prescale
+ * values of timer 2 differ from the CPU_CLK_PRESCALE names from
+ * CLK_DIV_64 on (see the datasheet), the asynchronous mode is not
+ * supported
+ ----------------------------------------------------------------------*/
+#define TIMER2_ACTIVATED 0
+#define TIMER2_MODE NORMAL
+#define TIMER2_OC_MODE NORMAL_CTC_NORMAL_DISCONNECTED
+#define TIMER2_PRESCALE CLK_DIV_64
+#define TIMER2_INTERRUPTS 0
+#define TIMER2_COMPARE 0
+
+#endif
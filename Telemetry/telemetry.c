@@ -0,0 +1,207 @@
+/*
+ * File : telemetry.c
+ *
+ * Description:
+ * File contains the necessary functions for streaming ADC samples over the
+ * USART as packed binary packets
+ *
+ * Note:
+ * For detail documentation about the packet format and the use of the
+ * functions refer the header file telemetry.h
+ * Refer to E:/Avrprojects/library/coding standards.doc for coding standards
+ *
+ */
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "usart.h"
+#include "telemetry.h"
+
+#if (TELEMETRY_SAMPLES_PER_PACKET % 4) || (TELEMETRY_SAMPLES_PER_PACKET > 200)
+#error "TELEMETRY_SAMPLES_PER_PACKET has to be a multiple of 4 not more than 200"
+#endif
+
+/* The sync bytes are the same for every packet and are sent from flash */
+#define TELEMETRY_SYNC_SIZE 2
+#define TELEMETRY_BODY_SIZE (TELEMETRY_PACKET_SIZE - TELEMETRY_SYNC_SIZE)
+static const uint8_t telemetry_sync[TELEMETRY_SYNC_SIZE] PROGMEM =
+{
+    TELEMETRY_SYNC_1, TELEMETRY_SYNC_2
+};
+
+/* Two packets from SEQ up to SUM, one is built while the other one is sent.
+ * telemetry_build is the index of the one being built and is only swapped
+ * while nothing is sent
+ */
+static uint8_t telemetry_packets[2][TELEMETRY_BODY_SIZE];
+static uint8_t telemetry_build;
+static uint8_t telemetry_count;
+static uint8_t telemetry_group;
+static uint8_t telemetry_sequence;
+static uint16_t telemetry_dropped;
+
+/* Set while a packet is in the USART segment queue */
+static volatile bool telemetry_sending;
+
+/*
+ * Function: telemetry_sent()
+ *
+ * Description: Completion callback of the last segment of a packet, called
+ * from the UDRE ISR. The packet buffer may be built into again
+ *
+ * Returns: Nothing
+ */
+static void telemetry_sent(void *context)
+{
+    (void)context;
+    telemetry_sending = false;
+}
+
+/*
+ * Function: telemetry_reset_packet()
+ *
+ * Description: Starts a new packet in the buffer being built
+ *
+ * Returns: Nothing
+ */
+static void telemetry_reset_packet()
+{
+    telemetry_count = 0;
+    telemetry_group = TELEMETRY_HEADER_SIZE - TELEMETRY_SYNC_SIZE;
+}
+
+/*
+ * Function: telemetry_send()
+ *
+ * Description: Fills in the header and the checksum of the packet being
+ * built and queues it with the sync bytes in flash as two USART segments,
+ * so it is sent without being copied
+ *
+ * Returns: false if the USART is still busy, the packet is left as it is
+ */
+static bool telemetry_send()
+{
+    uint8_t *packet = telemetry_packets[telemetry_build];
+    USART_SEGMENT segments[2];
+    uint8_t length;
+    uint8_t sum = 0;
+    uint8_t i;
+
+    if (telemetry_sending || (UsartSegmentQueueFree() < 2))
+    {
+        return false;
+    }
+
+    /* Clear the unused samples of a partly filled last group */
+    for (i = telemetry_count; i & 0x03; i++)
+    {
+        packet[telemetry_group + (i & 0x03)] = 0;
+    }
+    if (telemetry_count & 0x03)
+    {
+        telemetry_group += TELEMETRY_GROUP_SIZE;
+    }
+
+    packet[0] = telemetry_sequence++;
+    packet[1] = telemetry_count;
+    length = telemetry_group;
+    for (i = 0; i < length; i++)
+    {
+        sum += packet[i];
+    }
+    packet[length++] = sum;
+
+    segments[0].data = telemetry_sync;
+    segments[0].length = TELEMETRY_SYNC_SIZE;
+    segments[0].flags = USART_SEGMENT_FLASH;
+    segments[0].done = NULL;
+    segments[0].context = NULL;
+    segments[1].data = packet;
+    segments[1].length = length;
+    segments[1].flags = USART_SEGMENT_RAM;
+    segments[1].done = telemetry_sent;
+    segments[1].context = NULL;
+
+    /* Swap the buffers, the ISR reads the one that is not being built */
+    telemetry_sending = true;
+    telemetry_build ^= 1;
+    UsartQueueSegments(segments, 2);
+
+    telemetry_reset_packet();
+    return true;
+}
+
+void TelemetryInit()
+{
+    telemetry_build = 0;
+    telemetry_sequence = 0;
+    telemetry_dropped = 0;
+    telemetry_reset_packet();
+}
+
+/*
+ * Function: TelemetryAddSample()
+ *
+ * Description: Packs the sample into the current group of the packet being
+ * built. For more details see telemetry.h
+ *
+ * Returns: Nothing
+ */
+void TelemetryAddSample(uint16_t sample)
+{
+    uint8_t *group = &telemetry_packets[telemetry_build][telemetry_group];
+    uint8_t slot = telemetry_count & 0x03;
+
+    if (slot == 0)
+    {
+        group[4] = 0;
+    }
+    group[slot] = (uint8_t)sample;
+    group[4] |= (uint8_t)((sample >> 8) & 0x03) << (slot * 2);
+
+    telemetry_count++;
+    if (slot == 3)
+    {
+        telemetry_group += TELEMETRY_GROUP_SIZE;
+    }
+
+    if (telemetry_count == TELEMETRY_SAMPLES_PER_PACKET)
+    {
+        if (!telemetry_send())
+        {
+            /* Never wait for the link, drop the packet and keep sampling */
+            telemetry_sequence++;
+            telemetry_dropped++;
+            telemetry_reset_packet();
+        }
+    }
+}
+
+void TelemetryAddSamples(const uint16_t *samples, uint8_t count)
+{
+    while (count--)
+    {
+        TelemetryAddSample(*samples++);
+    }
+}
+
+bool TelemetryFlush()
+{
+    if (telemetry_count == 0)
+    {
+        return true;
+    }
+    return telemetry_send();
+}
+
+bool TelemetryIsBusy()
+{
+    return telemetry_sending;
+}
+
+uint16_t TelemetryDroppedPackets()
+{
+    return telemetry_dropped;
+}
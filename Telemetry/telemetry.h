@@ -0,0 +1,82 @@
+/************************************************************************
+ * Name : telemetry.h
+ *
+ * Header file for the telemetry.c file
+ *
+ * Contains the packet format, macros and function definitions for streaming
+ * ADC samples over the USART in a compact binary form
+ ************************************************************************/
+/************
+Packet format
+
+	Every packet carries up to TELEMETRY_SAMPLES_PER_PACKET samples of 10 bits,
+	packed four samples into five bytes :
+
+	------------------------------------------------------------------------
+	| 0xA5 | 0x5A | SEQ | COUNT | GROUP 0 | GROUP 1 | ... | GROUP n | SUM |
+	------------------------------------------------------------------------
+	SEQ   : Sequence counter, incremented for every packet built (also for the
+	        ones dropped because the link was busy), so gaps show lost packets
+	COUNT : Number of samples in the packet, the number of groups is
+	        (COUNT + 3) / 4. Unused samples of the last group are 0
+	GROUP : Five bytes for four samples s0..s3
+	        ------------------------------------------------------------
+	        | s0[7:0] | s1[7:0] | s2[7:0] | s3[7:0] | s3 s2 s1 s0 [9:8] |
+	        ------------------------------------------------------------
+	        the last byte holds the upper two bits of each sample, s0 in
+	        bits 1:0 up to s3 in bits 7:6
+	SUM   : 8 bit sum of all bytes from SEQ up to the last group
+
+	Sent as ASCII with UsartSendInteger() a sample takes 5 to 6 bytes plus a
+	separator, here it takes 1.25 bytes plus 5 bytes per packet.
+*************/
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Samples per packet, has to be a multiple of 4 and not more than 200 */
+#define TELEMETRY_SAMPLES_PER_PACKET 32
+
+#define TELEMETRY_SYNC_1 0xA5
+#define TELEMETRY_SYNC_2 0x5A
+#define TELEMETRY_HEADER_SIZE 4
+#define TELEMETRY_GROUP_SIZE 5
+#define TELEMETRY_PACKET_SIZE (TELEMETRY_HEADER_SIZE + \
+                               (TELEMETRY_SAMPLES_PER_PACKET / 4) * TELEMETRY_GROUP_SIZE + 1)
+
+/** @brief Reset the packet builder and the sequence counter
+ *
+ * The USART has to be set up with UsartInit() before packets are sent
+ */
+void TelemetryInit();
+
+/** @brief Add one sample to the packet being built
+ *
+ * When the packet is full it is handed to the USART, which sends it from the
+ * data register empty interrupt while the next packet is being built. If the
+ * previous packet is still being sent the full one is dropped and counted,
+ * the caller is never blocked.
+ * @param sample 10 bit sample, the upper bits are ignored
+ */
+void TelemetryAddSample(uint16_t sample);
+
+/** @brief Add a block of samples, e.g. as read with AdcStreamRead() */
+void TelemetryAddSamples(const uint16_t *samples, uint8_t count);
+
+/** @brief Send the packet being built even if it is not full
+ * @return false if the previous packet is still being sent
+ */
+bool TelemetryFlush();
+
+/** @brief Check if a packet is still being sent
+ * @return true while the USART is busy with a packet
+ */
+bool TelemetryIsBusy();
+
+/** @brief Number of full packets dropped because the link was busy */
+uint16_t TelemetryDroppedPackets();
+
+#endif
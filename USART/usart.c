@@ -11,20 +11,193 @@
  */
 
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <avr/pgmspace.h>
+#include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "usart.h"
+#include "usartpinconfig.h"
+#include "format.h"
 
-void UsartInit(USART_MODE mode,PARITY_SETTING parity,STOP_BITS stop_bits,CHARACTER_SIZE ch_size, BAUD_RATE baud_rate)
+#if (USART_TX_BUFFER_SIZE & (USART_TX_BUFFER_SIZE - 1)) || (USART_TX_BUFFER_SIZE > 128) || (USART_TX_BUFFER_SIZE < 8)
+#error "USART_TX_BUFFER_SIZE has to be a power of two from 8 up to 128"
+#endif
+#if (USART_RX_BUFFER_SIZE & (USART_RX_BUFFER_SIZE - 1)) || (USART_RX_BUFFER_SIZE > 128) || (USART_RX_BUFFER_SIZE < 8)
+#error "USART_RX_BUFFER_SIZE has to be a power of two from 8 up to 128"
+#endif
+#define USART_TX_BUFFER_MASK (USART_TX_BUFFER_SIZE - 1)
+#define USART_RX_BUFFER_MASK (USART_RX_BUFFER_SIZE - 1)
+#if (USART_SEGMENT_QUEUE_SIZE & (USART_SEGMENT_QUEUE_SIZE - 1)) || (USART_SEGMENT_QUEUE_SIZE > 128)
+#error "USART_SEGMENT_QUEUE_SIZE has to be a power of two not more than 128"
+#endif
+#define USART_SEGMENT_QUEUE_MASK (USART_SEGMENT_QUEUE_SIZE - 1)
+
+#if USART_FLOW_CONTROL
+#if (USART_RTS_HIGH_WATER > USART_RX_BUFFER_SIZE) || (USART_RTS_LOW_WATER >= USART_RTS_HIGH_WATER)
+#error "USART_RTS_LOW_WATER has to be below USART_RTS_HIGH_WATER, which has to fit the receive buffer"
+#endif
+#define RtsStop() (USART_RTS_PORT |= (1<<USART_RTS_PIN))
+#define RtsGo() (USART_RTS_PORT &= ~(1<<USART_RTS_PIN))
+#define CtsStop() (USART_CTS_PIN_REG & (1<<USART_CTS_PIN))
+#endif
+
+/* The ninth bits of 9 bit characters are kept in bit arrays next to the ring
+ * buffers, index is the already masked ring index */
+#define Bit8Get(array,index) ((array)[(index) >> 3] & (1 << ((index) & 7)))
+#define Bit8Set(array,index) ((array)[(index) >> 3] |= (1 << ((index) & 7)))
+#define Bit8Clear(array,index) ((array)[(index) >> 3] &= ~(1 << ((index) & 7)))
+
+/* Ring buffers. The head is written by the producer and the tail by the
+ * consumer only (main loop and ISR), both run freely and are masked when
+ * indexing so head - tail is the fill level.
+ */
+static volatile uint8_t usart_tx_buffer[USART_TX_BUFFER_SIZE];
+static volatile uint8_t usart_tx_head;
+static volatile uint8_t usart_tx_tail;
+static volatile uint8_t usart_rx_buffer[USART_RX_BUFFER_SIZE];
+static volatile uint8_t usart_rx_head;
+static volatile uint8_t usart_rx_tail;
+static volatile uint8_t usart_tx_bit8[USART_TX_BUFFER_SIZE / 8];
+static volatile uint8_t usart_rx_bit8[USART_RX_BUFFER_SIZE / 8];
+/* Set by UsartInit() for 9 bit characters, the bit arrays are only used then */
+static bool usart_nine_bits;
+/* Set by the ISR when a byte is written to UDR, cleared by UsartFlush() */
+static volatile bool usart_tx_pending;
+
+/* Byte source currently feeding the UDRE interrupt, NULL when idle */
+static volatile USART_TX_SOURCE usart_tx_source;
+
+/* Transmit segment queue. The descriptor at the tail is the one being sent,
+ * the ISR moves its data pointer and length on as it goes */
+static USART_SEGMENT usart_segments[USART_SEGMENT_QUEUE_SIZE];
+static volatile uint8_t usart_segment_head;
+static volatile uint8_t usart_segment_tail;
+
+/* Handler taking the received bytes, NULL to fill the receive ring buffer */
+static volatile USART_RX_HANDLER usart_rx_handler;
+
+/* Error counters, updated in the RXC ISR */
+static volatile USART_STATS usart_stats;
+
+/* Multi-processor communication mode, see UsartSetNodeAddress() */
+static volatile bool usart_address_filter;
+static volatile uint8_t usart_node_address;
+
+/*
+ * Function: usart_baud_error()
+ *
+ * Description: Works out the UBRR value nearest to the wanted baud rate for
+ * the divisor passed in (16 normal speed, 8 double speed, 2 synchronous)
+ *
+ * Returns: The error of the rate reached in 1/1000 of the wanted rate
+ */
+static uint16_t usart_baud_error(uint32_t baud, uint32_t divisor, uint16_t *ubrr)
+{
+	/* value is UBRR + 1, rounded to the nearest */
+	uint32_t value = (F_CPU + (divisor * baud) / 2) / (divisor * baud);
+	uint32_t actual;
+	uint32_t difference;
+
+	if (value == 0)
+	{
+		value = 1;
+	}
+	else if (value > 0x1000)
+	{
+		value = 0x1000;
+	}
+	*ubrr = (uint16_t)(value - 1);
+
+	actual = F_CPU / (divisor * value);
+	difference = (actual > baud) ? (actual - baud) : (baud - actual);
+	if (difference >= baud)
+	{
+		return 1000;
+	}
+	return (uint16_t)((difference * 1000) / baud);
+}
+
+/*
+ * Function: UsartInit()
+ *
+ * Description: Sets up the USART. The baud rate is worked out first so that
+ * a rate that can not be reached leaves the USART as it was. For more
+ * details see usart.h
+ *
+ * Returns: false if the asynchronous baud rate is more than 2% off
+ */
+bool UsartInit(USART_MODE mode,PARITY_SETTING parity,STOP_BITS stop_bits,CHARACTER_SIZE ch_size, BAUD_RATE baud_rate)
 {  
 	uint16_t ubrr_val = 0;
+	uint16_t ubrr_2x = 0;
+	uint16_t error;
+	uint16_t error_2x;
+	bool use_2x = false;
     uint8_t value = 0;
 
+ 	/* Work out the baud rate
+	 * In asynchronous mode both normal and double speed (U2X) are worked out
+	 * and the one closer to the wanted rate is taken, normal speed on a tie as
+	 * it samples each bit more often. More than 2% off is rejected, the
+	 * receiver would miss bits. A rate checked at compile time through
+	 * USART_BAUD (see usart.h) needs no working out here. In synchronous mode
+	 * the clock goes with the data and any rate is fine.
+	 */
+	if (mode == SYNCHRONOUS)
+	{
+		usart_baud_error(baud_rate, 2UL, &ubrr_val);
+	}
+#ifdef USART_BAUD
+	else if ((uint32_t)baud_rate == (USART_BAUD))
+	{
+		ubrr_val = USART_BAUD_UBRR;
+		use_2x = USART_BAUD_USE_2X;
+	}
+#endif
+	else
+	{
+		error_2x = usart_baud_error(baud_rate, 8UL, &ubrr_2x);
+		error = usart_baud_error(baud_rate, 16UL, &ubrr_val);
+		if (error_2x < error)
+		{
+			ubrr_val = ubrr_2x;
+			use_2x = true;
+			error = error_2x;
+		}
+		if (error > USART_MAX_BAUD_ERROR_PERMILLE)
+		{
+			return false;
+		}
+	}
+
+#if USART_FLOW_CONTROL
+	/* RTS output, ready to receive. CTS input, a change on INT1 restarts the
+	 * transmitter */
+	RtsGo();
+	USART_RTS_DDR |= (1<<USART_RTS_PIN);
+	USART_CTS_DDR &= ~(1<<USART_CTS_PIN);
+	MCUCR = (MCUCR & ~((1<<ISC11)|(1<<ISC10))) | (1<<ISC10);
+	GIFR = (1<<INTF1);
+	GICR |= (1<<INT1);
+#endif
+
 	/* USART initialization: 
 	 *  Enable the receiver and the transmitter (in UCSRB register) */ 
     EnableRxTx();
+    /* Received bytes are moved to the ring buffer by the RXC interrupt */
+    EnableRxInterrupt();
  
- 	/* Set the baud rate in the UBBRs */ 
-	ubrr_val = ( uint16_t ) ( (F_CPU/(16UL * baud_rate))- 1 );
+	/* Set the baud rate in the UBBRs, only U2X is changed, MPCM is kept and the error flags written as zero */
+	if (use_2x)
+	{
+		UCSRA = (UCSRA & (1<<MPCM)) | (1<<U2X);
+	}
+	else
+	{
+		UCSRA = (UCSRA & (1<<MPCM));
+	}
 	UBRRH = ubrr_val >> 8;
 	UBRRL = ubrr_val;
 
@@ -49,25 +222,32 @@ void UsartInit(USART_MODE mode,PARITY_SETTING parity,STOP_BITS stop_bits,CHARACT
 		
 	}
 
-    /* Set the character size (in UCSRC register ) 
-	 * At the moment only 8 bit mode is supported and is the default.. 
-	 * Any other value passed will result in the default being selected 
-	 * TODO: Implemet handling different character sizes
+    /* Set the character size 
+	 * The enum values are the UCSZ2:0 bits as per datasheet, UCSZ1:0 go to
+	 * the UCSRC register and UCSZ2 to the UCSRB register. Any other value
+	 * passed will result in 8 bits being selected
 	 */
   	switch( ch_size )
 	{
+		case CHARACTER_SIZE_5_BITS :
+		case CHARACTER_SIZE_6_BITS :
+		case CHARACTER_SIZE_7_BITS :
 		case CHARACTER_SIZE_8_BITS :
-		    value |= (3<<UCSZ0);
+		    value |= (ch_size<<UCSZ0);
+		    UCSRB &= ~(1<<UCSZ2);
+		    usart_nine_bits = false;
 	    break;
 
-		/* rest of them would fall through and default to 8 bits of character*/ 
-		case CHARACTER_SIZE_7_BITS :
-		case CHARACTER_SIZE_6_BITS :
-		case CHARACTER_SIZE_5_BITS :
 		case CHARACTER_SIZE_9_BITS :
+		    value |= (3<<UCSZ0);
+		    UCSRB |= (1<<UCSZ2);
+		    usart_nine_bits = true;
+	    break;
 
 		default :
 		    value |= (3<<UCSZ0);
+		    UCSRB &= ~(1<<UCSZ2);
+		    usart_nine_bits = false;
 		break;    
     }
 		  
@@ -108,28 +288,262 @@ void UsartInit(USART_MODE mode,PARITY_SETTING parity,STOP_BITS stop_bits,CHARACT
 	    value |= (1<<USBS); 
 	}
 
-	/* Now Load the value to the UCSRC by setting the URSEl bit to 1*/
-	UCSRC |= ((value)|(1<<URSEL));		  
+	/* Now Load the value to the UCSRC by setting the URSEl bit to 1
+	 * It is written as a whole, a single read of this address returns UBRRH
+	 * and not UCSRC, so it can not be read-modify-written
+	 */
+	UCSRC = ((value)|(1<<URSEL));		  
 
+	return true;
 }
 
+/*
+ * Function: UsartSend()
+ *
+ * Description: Queues the byte for sending, waits only while the transmit
+ * ring buffer is full
+ *
+ * Returns: Nothing
+ */
 void UsartSend(unsigned char data)
 {
-    /* Wait for empty transmit buffer */
-    while ( !( UCSRA & (1<<UDRE)) );
-    /* Put data into buffer, sends the data */
-    UDR = data;
+    while (UsartWrite(&data, 1) == 0);
 }
 
+/*
+ * Function: UsartReceive()
+ *
+ * Description: Waits until a byte is in the receive ring buffer
+ *
+ * Returns: The received byte
+ */
 unsigned char UsartReceive(void)
 {
 	unsigned char data;
-    while ( !( UCSRA & (1<<RXC)) );
-    /* Put data into buffer, sends the data */
-    data = UDR;
+    while (UsartRead(&data, 1) == 0);
+    return data;
+}
+
+/*
+ * Function: UsartWrite()
+ *
+ * Description: Copies as many bytes as fit into the transmit ring buffer and
+ * enables the data register empty interrupt. For more details see usart.h
+ *
+ * Returns: The number of bytes queued
+ */
+uint8_t UsartWrite(const uint8_t *data, uint8_t length)
+{
+    uint8_t head = usart_tx_head;
+    uint8_t free = USART_TX_BUFFER_SIZE - (uint8_t)(head - usart_tx_tail);
+    uint8_t i;
+
+    if (length > free)
+    {
+        length = free;
+    }
+
+    for (i = 0; i < length; i++)
+    {
+        usart_tx_buffer[head & USART_TX_BUFFER_MASK] = data[i];
+        if (usart_nine_bits)
+        {
+            Bit8Clear(usart_tx_bit8, head & USART_TX_BUFFER_MASK);
+        }
+        head++;
+    }
+    usart_tx_head = head;
+
+    if (length)
+    {
+        EnableTxInterrupt();
+    }
+    return length;
+}
+
+/*
+ * Function: UsartRead()
+ *
+ * Description: Copies the received bytes out of the ring buffer. For more
+ * details see usart.h
+ *
+ * Returns: The number of bytes copied
+ */
+uint8_t UsartRead(uint8_t *data, uint8_t length)
+{
+    uint8_t tail = usart_rx_tail;
+    uint8_t count = (uint8_t)(usart_rx_head - tail);
+    uint8_t i;
+
+    if (length > count)
+    {
+        length = count;
+    }
+
+    for (i = 0; i < length; i++)
+    {
+        data[i] = usart_rx_buffer[tail & USART_RX_BUFFER_MASK];
+        tail++;
+    }
+    usart_rx_tail = tail;
+#if USART_FLOW_CONTROL
+    if ((uint8_t)(usart_rx_head - tail) <= USART_RTS_LOW_WATER)
+    {
+        RtsGo();
+    }
+#endif
+    return length;
+}
+
+/*
+ * Function: UsartSend9()
+ *
+ * Description: Queues a 9 bit character for sending, waits only while the
+ * transmit ring buffer is full. For more details see usart.h
+ *
+ * Returns: Nothing
+ */
+void UsartSend9(uint16_t data)
+{
+    uint8_t head = usart_tx_head;
+    uint8_t index = head & USART_TX_BUFFER_MASK;
+
+    while ((uint8_t)(head - usart_tx_tail) >= USART_TX_BUFFER_SIZE);
+
+    usart_tx_buffer[index] = (uint8_t)data;
+    if (data & 0x100)
+    {
+        Bit8Set(usart_tx_bit8, index);
+    }
+    else
+    {
+        Bit8Clear(usart_tx_bit8, index);
+    }
+    usart_tx_head = head + 1;
+    EnableTxInterrupt();
+}
+
+/*
+ * Function: UsartReceive9()
+ *
+ * Description: Waits for a received character and returns it with the
+ * ninth bit. For more details see usart.h
+ *
+ * Returns: The character, bit 8 is the ninth bit
+ */
+uint16_t UsartReceive9()
+{
+    uint8_t tail = usart_rx_tail;
+    uint8_t index = tail & USART_RX_BUFFER_MASK;
+    uint16_t data;
+
+    while (usart_rx_head == tail);
+
+    data = usart_rx_buffer[index];
+    if (Bit8Get(usart_rx_bit8, index))
+    {
+        data |= 0x100;
+    }
+    usart_rx_tail = tail + 1;
+#if USART_FLOW_CONTROL
+    if ((uint8_t)(usart_rx_head - tail - 1) <= USART_RTS_LOW_WATER)
+    {
+        RtsGo();
+    }
+#endif
     return data;
 }
 
+/*
+ * Function: UsartSetNodeAddress()
+ *
+ * Description: Turns on the multi-processor communication mode, from here on
+ * the receiver only takes address frames until one for this node comes in.
+ * For more details see usart.h
+ *
+ * Returns: Nothing
+ */
+void UsartSetNodeAddress(uint8_t address)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        usart_node_address = address;
+        usart_address_filter = true;
+        UCSRA = (UCSRA & (1<<U2X)) | (1<<MPCM);
+    }
+}
+
+void UsartDisableAddressFilter()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        usart_address_filter = false;
+        UCSRA = (UCSRA & (1<<U2X));
+    }
+}
+
+/*
+ * Function: UsartGetStats()
+ *
+ * Description: Copies the error counters, with interrupts off as the ISR
+ * updates them. For more details see usart.h
+ *
+ * Returns: Nothing
+ */
+void UsartGetStats(USART_STATS *stats)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        stats->frame_errors = usart_stats.frame_errors;
+        stats->overruns = usart_stats.overruns;
+        stats->parity_errors = usart_stats.parity_errors;
+        stats->dropped = usart_stats.dropped;
+    }
+}
+
+void UsartClearStats()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        usart_stats.frame_errors = 0;
+        usart_stats.overruns = 0;
+        usart_stats.parity_errors = 0;
+        usart_stats.dropped = 0;
+    }
+}
+
+uint8_t UsartAvailable()
+{
+    return (uint8_t)(usart_rx_head - usart_rx_tail);
+}
+
+uint8_t UsartTxFree()
+{
+    return USART_TX_BUFFER_SIZE - (uint8_t)(usart_tx_head - usart_tx_tail);
+}
+
+/*
+ * Function: UsartFlush()
+ *
+ * Description: Waits for the byte source, the segment queue and the
+ * transmit ring buffer to run empty and then for the transmit complete
+ * flag. UDRIE is no sign of that, with flow control the ISR switches it off
+ * while CTS holds the data back. For more details see usart.h
+ *
+ * Returns: Nothing
+ */
+void UsartFlush()
+{
+    while ((usart_tx_source != NULL) ||
+           (usart_segment_tail != usart_segment_head) ||
+           (usart_tx_tail != usart_tx_head));
+    if (usart_tx_pending)
+    {
+        while (!(UCSRA & (1<<TXC)));
+        usart_tx_pending = false;
+    }
+}
+
 void UsartSendString(char *msg)
 {
     while (*msg != '\0' )
@@ -139,51 +553,398 @@ void UsartSendString(char *msg)
 	}  
 }
 
+/*
+ * Function: UsartSendString_P()
+ *
+ * Description: Sends a string straight from flash. For more details see
+ * usart.h
+ *
+ * Returns: Nothing
+ */
+void UsartSendString_P(const char *msg)
+{
+    char c;
+
+    while ((c = pgm_read_byte(msg)) != '\0')
+    {
+        UsartSend(c);
+        msg++;
+    }
+}
+
+/* Character sink for FormatPrint_P() */
+static void usart_put(char c)
+{
+    UsartSend(c);
+}
+
+/*
+ * Function: UsartPrintf_P()
+ *
+ * Description: Sends the formatted output of a format string in flash. For
+ * more details see usart.h
+ *
+ * Returns: Nothing
+ */
+void UsartPrintf_P(const char *format, ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    FormatPrint_P(usart_put, format, args);
+    va_end(args);
+}
 
 /*
  * Function: UsartSendInteger()
  * 
- * Description: send the number passed in on the usart
+ * Description: send the number passed in on the usart, without leading
+ * zeros
  *
  * Returns: Nothing 
  */
 void UsartSendInteger(int16_t val)
 {
-	/*The variable number stores the remainder of the integer value being passed
-	   whereas, the temp_val is used to store the number after the remainder has 
-	   been stripped off 
-	*/
-	uint8_t number[5]= {0,0,0,0,0}; 
-    int8_t i;
-    bool is_val_neg = false;
-    if(val < 0)
+    UsartSendNumber(val, 0, ' ');
+}
+
+/*
+ * Function: UsartSendNumber()
+ *
+ * Description: send the number passed in on the usart in decimal, padded
+ * up to width with pad. For more details see usart.h
+ *
+ * Returns: Nothing
+ */
+void UsartSendNumber(int32_t val, uint8_t width, char pad)
+{
+    char buffer[FORMAT_BUFFER_SIZE];
+
+    FormatSigned(buffer, val, width, pad);
+    UsartSendString(buffer);
+}
+
+/*
+ * Function: UsartSendHex()
+ *
+ * Description: send the number passed in on the usart in hex with at least
+ * digits digits. For more details see usart.h
+ *
+ * Returns: Nothing
+ */
+void UsartSendHex(uint32_t val, uint8_t digits)
+{
+    char buffer[FORMAT_BUFFER_SIZE];
+
+    FormatHex(buffer, val, digits);
+    UsartSendString(buffer);
+}
+
+/*
+ * Function: UsartSendFixed()
+ *
+ * Description: send the fixed point number passed in on the usart. For
+ * more details see usart.h
+ *
+ * Returns: Nothing
+ */
+void UsartSendFixed(int32_t val, uint8_t decimals, uint8_t width)
+{
+    char buffer[FORMAT_BUFFER_SIZE];
+
+    FormatFixed(buffer, val, decimals, width, ' ');
+    UsartSendString(buffer);
+}
+
+/*
+ * Function: UsartStartTxSource()
+ *
+ * Description: Enables the data register empty interrupt, which then pulls
+ * the bytes from the source passed in. For more details see usart.h
+ *
+ * Returns: true if the source was started
+ */
+bool UsartStartTxSource(USART_TX_SOURCE source)
+{
+    if (usart_tx_source != NULL)
+    {
+        return false;
+    }
+    usart_tx_source = source;
+    UCSRB |= (1<<UDRIE);
+    return true;
+}
+
+bool UsartTxSourceBusy()
+{
+    return (usart_tx_source != NULL);
+}
+
+/*
+ * Function: UsartQueueSegments()
+ *
+ * Description: Copies the descriptors into the segment queue and makes them
+ * visible to the ISR in one go. For more details see usart.h
+ *
+ * Returns: false if there is no room for all the segments
+ */
+bool UsartQueueSegments(const USART_SEGMENT *segments, uint8_t count)
+{
+    uint8_t head = usart_segment_head;
+    uint8_t i;
+
+    if (count > UsartSegmentQueueFree())
     {
-       UsartSend('-');
-	   is_val_neg = true; 
+        return false;
     }
 
-    for(i= 0;i<=4;i++)
+    for (i = 0; i < count; i++)
     {
-        number[i] = val % 10;
-        val = val / 10;
+        usart_segments[head & USART_SEGMENT_QUEUE_MASK] = segments[i];
+        head++;
     }
-    
-	for(i= 4; i>= 0; i--)
-	{
-        /* This is to compensate for the fact that if the number is negative 
-            while sending the final ascii it adds a anegative number which means
-            an erronous value will be sent over */ 
-	    if(is_val_neg)
+
+    /* The barrier of the atomic block makes sure the descriptors are
+     * written before the ISR can see the new head */
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        usart_segment_head = head;
+        EnableTxInterrupt();
+    }
+    return true;
+}
+
+uint8_t UsartSegmentQueueFree()
+{
+    return USART_SEGMENT_QUEUE_SIZE - (uint8_t)(usart_segment_head - usart_segment_tail);
+}
+
+bool UsartSegmentQueueBusy()
+{
+    return (usart_segment_head != usart_segment_tail);
+}
+
+/*
+ * Function: usart_segment_next_byte()
+ *
+ * Description: Takes the next byte from the segment queue, called from the
+ * UDRE ISR. A segment is finished (callback and tail moved on) as soon as
+ * its last byte is taken, empty segments are finished on the way.
+ *
+ * Returns: The next byte, -1 if the queue is empty
+ */
+static int16_t usart_segment_next_byte(void)
+{
+    uint8_t tail = usart_segment_tail;
+    USART_SEGMENT *segment;
+    int16_t data = -1;
+
+    while ((data < 0) && (tail != usart_segment_head))
+    {
+        segment = &usart_segments[tail & USART_SEGMENT_QUEUE_MASK];
+        if (segment->length)
+        {
+            if (segment->flags & USART_SEGMENT_FLASH)
+            {
+                data = pgm_read_byte(segment->data);
+            }
+            else
+            {
+                data = *segment->data;
+            }
+            segment->data++;
+            segment->length--;
+            if (segment->length)
+            {
+                break;
+            }
+        }
+        if (segment->done != NULL)
+        {
+            segment->done(segment->context);
+        }
+        tail++;
+    }
+    usart_segment_tail = tail;
+    return data;
+}
+
+/*
+ * USART Data Register Empty interrupt. An active byte source is served
+ * first, then the segment queue and then the transmit ring buffer. Switches
+ * itself off when all of them have nothing more to send
+ */
+ISR(USART_UDRE_vect)
+{
+    int16_t data = -1;
+    uint8_t tail;
+
+#if USART_FLOW_CONTROL
+    /* The other side can not take more, the CTS interrupt starts again */
+    if (CtsStop())
+    {
+        DisableTxInterrupt();
+        return;
+    }
+#endif
+
+    if (usart_tx_source != NULL)
+    {
+        data = usart_tx_source();
+        if (data < 0)
+        {
+            usart_tx_source = NULL;
+        }
+    }
+
+    if ((data < 0) && (usart_segment_tail != usart_segment_head))
+    {
+        data = usart_segment_next_byte();
+    }
+
+    if (data < 0)
+    {
+        tail = usart_tx_tail;
+        if (tail == usart_tx_head)
         {
-            UsartSend((48 + (number[i] * -1)));			
+            DisableTxInterrupt();
+            return;
+        }
+        data = usart_tx_buffer[tail & USART_TX_BUFFER_MASK];
+        if (usart_nine_bits && Bit8Get(usart_tx_bit8, tail & USART_TX_BUFFER_MASK))
+        {
+            data |= 0x100;
+        }
+        usart_tx_tail = tail + 1;
+    }
+
+    /* The ninth bit has to be in TXB8 before the low bits go to UDR */
+    if (usart_nine_bits)
+    {
+        if (data & 0x100)
+        {
+            UCSRB |= (1<<TXB8);
         }
         else
         {
-            UsartSend((48 + number[i]));			
+            UCSRB &= ~(1<<TXB8);
         }
-	}   
+    }
+
+    /* Clear the transmit complete flag, UsartFlush() waits for it. FE, DOR
+     * and PE have to be written as zero, U2X and MPCM are kept
+     */
+    UCSRA = (UCSRA & ((1<<U2X)|(1<<MPCM))) | (1<<TXC);
+    UDR = (uint8_t)data;
+    usart_tx_pending = true;
 }
 
+/*
+ * Function: UsartSetRxHandler()
+ *
+ * Description: Sets the function the received bytes are handed to. For
+ * more details see usart.h
+ *
+ * Returns: Nothing
+ */
+void UsartSetRxHandler(USART_RX_HANDLER handler)
+{
+    usart_rx_handler = handler;
+}
+
+/*
+ * USART Receive Complete interrupt. Hands the byte to the receive handler if
+ * one is set, else moves it into the receive ring buffer. The byte is lost if
+ * the buffer is full.
+ * With the address filter on, an address frame (ninth bit set) for another
+ * node turns MPCM back on, so the hardware drops the data frames that follow
+ * without interrupting. An address frame for this node or a broadcast turns
+ * MPCM off and is passed on like a data frame.
+ * The error flags are counted, a byte with a frame or parity error is
+ * dropped. An overrun means bytes before this one were lost, the byte itself
+ * is good.
+ */
+ISR(USART_RXC_vect)
+{
+    /* The error flags and RXB8 belong to the byte in UDR and have to be read
+     * before it */
+    uint8_t status = UCSRA;
+    bool bit8 = (UCSRB & (1<<RXB8)) != 0;
+    uint8_t data = UDR;
+    uint8_t head = usart_rx_head;
+    uint8_t index = head & USART_RX_BUFFER_MASK;
+    USART_RX_HANDLER handler = usart_rx_handler;
 
+    if (status & (1<<DOR))
+    {
+        usart_stats.overruns++;
+    }
+    if (status & ((1<<FE)|(1<<PE)))
+    {
+        if (status & (1<<FE))
+        {
+            usart_stats.frame_errors++;
+        }
+        if (status & (1<<PE))
+        {
+            usart_stats.parity_errors++;
+        }
+        return;
+    }
+
+    if (usart_address_filter && bit8)
+    {
+        if ((data != usart_node_address) && (data != USART_BROADCAST_ADDRESS))
+        {
+            UCSRA = (UCSRA & (1<<U2X)) | (1<<MPCM);
+            return;
+        }
+        UCSRA = (UCSRA & (1<<U2X));
+    }
 
+    if (handler != NULL)
+    {
+        handler(data);
+    }
+    else if ((uint8_t)(head - usart_rx_tail) < USART_RX_BUFFER_SIZE)
+    {
+        usart_rx_buffer[index] = data;
+        if (usart_nine_bits)
+        {
+            if (bit8)
+            {
+                Bit8Set(usart_rx_bit8, index);
+            }
+            else
+            {
+                Bit8Clear(usart_rx_bit8, index);
+            }
+        }
+        usart_rx_head = head + 1;
+#if USART_FLOW_CONTROL
+        if ((uint8_t)(head + 1 - usart_rx_tail) >= USART_RTS_HIGH_WATER)
+        {
+            RtsStop();
+        }
+#endif
+    }
+    else
+    {
+        usart_stats.dropped++;
+    }
+}
 
+#if USART_FLOW_CONTROL
+/*
+ * CTS changed. When the other side is ready again the data register empty
+ * interrupt is turned back on, it switches itself off if there is nothing
+ * to send
+ */
+ISR(INT1_vect)
+{
+    if (!CtsStop())
+    {
+        EnableTxInterrupt();
+    }
+}
+#endif
@@ -47,8 +47,9 @@ REGISTERS
 	U2X (Bit 1): Double the USART Transmission Speed
 				 Setting this bit will double the transfer rate for asynchronous communication.
 	MPCM (Bit 0): Multi-processor Communication Mode
-                 This bit enables the multi-processor communication mode. The MPCM feature is not
-				 discussed in this book.
+                 This bit enables the multi-processor communication mode. When set, all incoming
+				 frames that are not address frames (ninth bit set with 9 bit characters) are
+				 ignored by the receiver. See UsartSetNodeAddress().
 	UCSRB
 	-------------------------------------------------------------			 
     | RXCIE | TXCIE | UDRIE | RXEN | TXEN | UCSZ2 | RXB8 | TXB8 |
@@ -68,10 +69,10 @@ REGISTERS
 					(character size) in a frame.
 	RXB8 (Bit 1): Receive data bit 8
 					This is the ninth data bit of the received character when using serial frames with nine
-					data bits. This bit is not used in this book.
+					data bits. It has to be read before UDR. See UsartReceive9().
 	TXB8 (Bit 0): Transmit data bit 8
 					This is the ninth data bit of the transmitted character when using serial frames with nine
-					data bits. This bit is not used in this book.
+					data bits. It has to be written before UDR. See UsartSend9().
 
 	UCSRC
 	--------------------------------------------------------------
@@ -111,12 +112,32 @@ UBBR :
 		   |	                                                         |
 		   |	UBBR (value in dec) = (Fosc/ (16(Desired Baud Rate)) - 1 |
 		   |_____________________________________________________________|
+	 With the U2X bit set in UCSRA (asynchronous mode only) the divisor is 8 in place of 16,
+	 which doubles the highest rate and gives finer steps at the high rates.
+	 The library works out both and takes the one with the smaller error.
 	 The URSEL bit selects which register is to be selected between accessing the UBRRH or the UCSRC register
 	 as they share the same address 		
 *************/ 
 #ifndef _USART_H_
 #define _USART_H_
 
+#include <stdint.h>
+#include <stdbool.h>
+#include <avr/pgmspace.h>
+
+/* Sizes of the interrupt driven transmit and receive ring buffers, have to
+ * be powers of two and not more than 128 */
+#define USART_TX_BUFFER_SIZE 64
+#define USART_RX_BUFFER_SIZE 64
+
+/* Number of segments the transmit queue holds, has to be a power of two
+ * not more than 128 */
+#define USART_SEGMENT_QUEUE_SIZE 8
+
+/* Address frame taken by every node in the multi-processor communication
+ * mode */
+#define USART_BROADCAST_ADDRESS 0xFF
+
 /* ENUMS*/
 
 typedef enum PARITY_SETTING
@@ -138,6 +159,7 @@ typedef enum STOP_BITS
 	TWO_BITS  /* 1 */
 }STOP_BITS;
 
+/* The values are the UCSZ2:0 bits */
 typedef enum CHARACTER_SIZE
 {
 	CHARACTER_SIZE_5_BITS,
@@ -147,8 +169,40 @@ typedef enum CHARACTER_SIZE
 	CHARACTER_SIZE_9_BITS = 7
 }CHARACTER_SIZE;
 
+/* Where the data of a transmit segment is */
+#define USART_SEGMENT_RAM 0x00
+#define USART_SEGMENT_FLASH 0x01
+
+/* Called from the UDRE ISR once the last byte of a segment has been handed
+ * to the transmitter, from then on its data may be reused */
+typedef void (*USART_SEGMENT_DONE)(void *context);
+
+/* One piece of a frame for the transmit queue, see UsartQueueSegments() */
+typedef struct
+{
+    const uint8_t *data;     /* Bytes to send, in RAM or flash */
+    uint8_t length;          /* Number of bytes, may be 0 */
+    uint8_t flags;           /* USART_SEGMENT_RAM or USART_SEGMENT_FLASH */
+    USART_SEGMENT_DONE done; /* Completion callback, NULL for none */
+    void *context;           /* Passed to the callback */
+}USART_SEGMENT;
+
+/* Receive error counters, see UsartGetStats() */
+typedef struct
+{
+    uint16_t frame_errors;  /* Bytes with a wrong stop bit (FE), dropped */
+    uint16_t overruns;      /* Data overruns (DOR), bytes lost before the ISR ran */
+    uint16_t parity_errors; /* Bytes with a parity error (PE), dropped */
+    uint16_t dropped;       /* Good bytes lost as the receive ring buffer was full */
+}USART_STATS;
+
 typedef enum BAUD_RATE
 {
+	BAUD_RATE_1000000 = 1000000,
+	BAUD_RATE_500000 = 500000,
+	BAUD_RATE_250000 = 250000,
+	BAUD_RATE_115200 = 115200,
+	BAUD_RATE_57600 = 57600,
 	BAUD_RATE_38400 = 38400,
 	BAUD_RATE_19200 = 19200,
 	BAUD_RATE_9600  = 9600, 
@@ -157,17 +211,246 @@ typedef enum BAUD_RATE
 	BAUD_RATE_1200  = 1200
 }BAUD_RATE;
 
+/* Source of bytes for the interrupt driven transmit, called from the UDRE ISR.
+ * Returns the next byte to send or -1 when there is nothing more to send */
+typedef int16_t (*USART_TX_SOURCE)(void);
+
+/* Receiver for the incoming bytes, called from the RXC ISR instead of putting
+ * the byte into the receive ring buffer */
+typedef void (*USART_RX_HANDLER)(uint8_t data);
+
 /* MACROS*/
 //#define FOSC 8000000 
 //#define DENOMINATOR 16*FOSC
+
+/* Baud rate calculation for the compile time check below. divisor is 16 for
+ * normal speed and 8 with U2X. The UBRR value is rounded to the nearest one
+ * and the error is given in 1/1000 of the wanted rate.
+ */
+#define USART_MAX_BAUD_ERROR_PERMILLE 20
+#define USART_UBRR(baud,divisor) (((F_CPU) + (divisor) * (baud) / 2) / ((divisor) * (baud)) - 1)
+#define USART_ACTUAL_BAUD(baud,divisor) ((F_CPU) / ((divisor) * (USART_UBRR(baud,divisor) + 1)))
+#define USART_BAUD_ERROR_PERMILLE(baud,divisor) \
+	(((USART_ACTUAL_BAUD(baud,divisor) > (baud)) ? \
+	  (USART_ACTUAL_BAUD(baud,divisor) - (baud)) : \
+	  ((baud) - USART_ACTUAL_BAUD(baud,divisor))) * 1000 / (baud))
+
+/* Define USART_BAUD (e.g. -DUSART_BAUD=115200UL) to have the rate checked at
+ * compile time. The build fails if neither normal nor double speed gets
+ * within 2% of it at this F_CPU. UsartInit() called with this rate then uses
+ * the values worked out here and does no division at run time.
+ */
+#ifdef USART_BAUD
+	#if (F_CPU) < 8 * (USART_BAUD)
+		#error "USART_BAUD can not be reached at this F_CPU"
+	#else
+		#if (USART_BAUD_ERROR_PERMILLE(USART_BAUD,8UL) < USART_BAUD_ERROR_PERMILLE(USART_BAUD,16UL)) && \
+		    (USART_UBRR(USART_BAUD,8UL) < 0x1000)
+			#define USART_BAUD_USE_2X 1
+			#define USART_BAUD_UBRR USART_UBRR(USART_BAUD,8UL)
+			#define USART_BAUD_ERROR USART_BAUD_ERROR_PERMILLE(USART_BAUD,8UL)
+		#else
+			#define USART_BAUD_USE_2X 0
+			#define USART_BAUD_UBRR USART_UBRR(USART_BAUD,16UL)
+			#define USART_BAUD_ERROR USART_BAUD_ERROR_PERMILLE(USART_BAUD,16UL)
+		#endif
+		#if USART_BAUD_UBRR > 0x0FFF
+			#error "USART_BAUD is too low for this F_CPU"
+		#elif USART_BAUD_ERROR > USART_MAX_BAUD_ERROR_PERMILLE
+			#error "USART_BAUD is more than 2% off at this F_CPU, pick another rate or crystal"
+		#endif
+	#endif
+#endif
+
 #define EnableRxTx()  UCSRB |= ((1<<RXEN) | (1<<TXEN))
+#define EnableRxInterrupt() UCSRB |= (1<<RXCIE)
+#define EnableTxInterrupt() UCSRB |= (1<<UDRIE)
+#define DisableTxInterrupt() UCSRB &= ~(1<<UDRIE)
 
-void UsartInit(USART_MODE mode,PARITY_SETTING parity,STOP_BITS stop_bits,
+/* The transmit and receive are buffered and driven by the RXC and UDRE
+ * interrupts, global interrupts have to be enabled (sei()) after UsartInit().
+ * UsartWrite() and UsartRead() never wait, UsartSend() and UsartReceive() wait
+ * for space in or data from the ring buffers. None of them is meant to be
+ * called from an ISR.
+ * In asynchronous mode UsartInit() returns false and leaves the USART alone
+ * if neither normal nor double speed gets within 2% of baud_rate at this
+ * F_CPU (e.g. 115200 at 16 MHz is 2.1% off), USART_BAUD moves that check to
+ * compile time.
+ */
+bool UsartInit(USART_MODE mode,PARITY_SETTING parity,STOP_BITS stop_bits,
                CHARACTER_SIZE ch_size, BAUD_RATE baud_rate );
 void UsartSend(unsigned char data);
 void UsartSendString(char *msg);
 void UsartSendInteger(int16_t val);
 unsigned char UsartReceive();
 
+/** @brief Send a string stored in flash
+ *
+ * The string is read with pgm_read_byte() and never copied to SRAM
+ * @param msg String in flash, e.g. declared with PROGMEM or from PSTR()
+ */
+void UsartSendString_P(const char *msg);
+
+/** @brief Send a string literal from flash, e.g. UsartSendStringF("Ready\r\n")
+ *
+ * Unlike UsartSendString("...") the literal takes no SRAM
+ */
+#define UsartSendStringF(msg) UsartSendString_P(PSTR(msg))
+
+/** @brief printf to the usart with the format string in flash
+ *
+ * See FormatPrint_P() in format.h for the supported conversions
+ * @param format Format string in flash
+ */
+void UsartPrintf_P(const char *format, ...);
+
+/** @brief printf to the usart with a literal format string kept in flash,
+ * e.g. UsartPrintf("ADC%d=%u\r\n", channel, value)
+ */
+#define UsartPrintf(format, ...) UsartPrintf_P(PSTR(format), ##__VA_ARGS__)
+
+/** @brief Send a number in decimal
+ * @param val The number to send
+ * @param width Minimum number of characters, 0 for no padding
+ * @param pad Padding character, '0' or ' '
+ */
+void UsartSendNumber(int32_t val, uint8_t width, char pad);
+
+/** @brief Send a number in upper case hex without a prefix
+ * @param digits Minimum number of digits, filled up with '0'
+ */
+void UsartSendHex(uint32_t val, uint8_t digits);
+
+/** @brief Send a fixed point number, val is the number times 10^decimals
+ * @param width Minimum number of characters, padded with spaces
+ */
+void UsartSendFixed(int32_t val, uint8_t decimals, uint8_t width);
+
+/** @brief Queue bytes for sending without waiting
+ * @param data Bytes to send
+ * @param length Number of bytes in data
+ * @return number of bytes queued, less than length if the ring buffer is full
+ */
+uint8_t UsartWrite(const uint8_t *data, uint8_t length);
+
+/** @brief Take received bytes out of the ring buffer without waiting
+ * @param data Buffer the bytes are copied to
+ * @param length Size of data
+ * @return number of bytes copied, 0 if nothing was received
+ */
+uint8_t UsartRead(uint8_t *data, uint8_t length);
+
+/** @brief Number of received bytes waiting in the ring buffer */
+uint8_t UsartAvailable();
+
+/** @brief Copy the receive error counters
+ *
+ * Every error flag is checked in the receive interrupt before UDR is read,
+ * so no error goes by unnoticed. With RTS/CTS flow control (see
+ * usartpinconfig.h) dropped stays 0 as long as the other side obeys RTS.
+ * @param stats Filled in with the counters
+ */
+void UsartGetStats(USART_STATS *stats);
+
+/** @brief Set the receive error counters back to 0 */
+void UsartClearStats();
+
+/** @brief Free space in the transmit ring buffer */
+uint8_t UsartTxFree();
+
+/** @brief Wait until every queued byte has left the transmitter
+ *
+ * Returns once the transmit ring buffer, the segment queue and any byte
+ * source are done and the last stop bit has been shifted out. With
+ * USART_FLOW_CONTROL it keeps waiting as long as CTS holds the data back
+ */
+void UsartFlush();
+
+/** @brief Hand the transmitter over to a byte source
+ *
+ * The USART Data Register Empty interrupt pulls the bytes from the source one
+ * by one until it returns -1, so sending a block of data does not block the
+ * caller. While the source is active it has the transmitter to itself, bytes
+ * queued with UsartWrite()/UsartSend() go out after it.
+ * Global interrupts have to be enabled (sei()).
+ * @param source Function giving the next byte, called from the ISR
+ * @return false if another source is still sending
+ */
+bool UsartStartTxSource(USART_TX_SOURCE source);
+
+/** @brief Check if a byte source is still sending
+ * @return true until the source returned -1
+ */
+bool UsartTxSourceBusy();
+
+/** @brief Queue the segments of a frame for sending without copying them
+ *
+ * The descriptors are copied into the transmit queue, the data stays where
+ * it is (a header in RAM, a payload in a sensor buffer, a trailer in flash
+ * etc.) and is read by the UDRE interrupt segment by segment in order, so
+ * the data must not change until the segment's callback has run. All
+ * segments are queued or none, so a frame is never torn apart. Queued
+ * segments are sent after an active byte source (UsartStartTxSource()) and
+ * before the bytes of the transmit ring buffer (UsartWrite()/UsartSend()).
+ * Never waits, not meant to be called from an ISR.
+ * @param segments Descriptors of the segments, in order
+ * @param count Number of segments
+ * @return false if the queue does not have room for all of them
+ */
+bool UsartQueueSegments(const USART_SEGMENT *segments, uint8_t count);
+
+/** @brief Number of free places in the transmit segment queue */
+uint8_t UsartSegmentQueueFree();
+
+/** @brief Check if segments are still being sent
+ * @return true until the last queued segment is done
+ */
+bool UsartSegmentQueueBusy();
+
+/** @brief Hand every received byte to a handler instead of the ring buffer
+ *
+ * The handler runs in the USART Receive Complete interrupt, so it has to be
+ * short. While a handler is set UsartRead()/UsartReceive() get no data and
+ * RTS flow control is not done, the handler has to keep up.
+ * @param handler Function taking the byte, NULL to go back to the ring buffer
+ */
+void UsartSetRxHandler(USART_RX_HANDLER handler);
+
+/** @brief Queue a 9 bit character, waits while the ring buffer is full
+ *
+ * Needs CHARACTER_SIZE_9_BITS. The other send functions send the ninth bit
+ * as 0, a byte source (USART_TX_SOURCE) can return values up to 0x1FF.
+ * @param data Character, bit 8 is the ninth bit
+ */
+void UsartSend9(uint16_t data);
+
+/** @brief Send an address frame on a multidrop bus (ninth bit set) */
+#define UsartSendAddress(address) UsartSend9(0x100 | (uint8_t)(address))
+
+/** @brief Wait for a received character and return it with its ninth bit
+ *
+ * Needs CHARACTER_SIZE_9_BITS, UsartReceive()/UsartRead() drop the ninth
+ * bit. With the address filter on, a character with bit 8 set is the
+ * address frame starting a message for this node.
+ * @return the character, bit 8 is the ninth bit
+ */
+uint16_t UsartReceive9();
+
+/** @brief Receive only the messages for this node on a multidrop bus
+ *
+ * Turns on the multi-processor communication mode (MPCM). The hardware then
+ * ignores data frames without interrupting until an address frame for this
+ * node or USART_BROADCAST_ADDRESS arrives, the data frames after it are
+ * received until an address frame for another node comes in. Needs
+ * CHARACTER_SIZE_9_BITS, the master sends the addresses with
+ * UsartSendAddress().
+ * @param address Address of this node
+ */
+void UsartSetNodeAddress(uint8_t address);
+
+/** @brief Turn the multi-processor communication mode off, every frame is
+ * received again */
+void UsartDisableAddressFilter();
+
 #endif
 
@@ -0,0 +1,37 @@
+/************************************************************************
+ * Name : usartpinconfig.h 
+ * 
+ * Header file for the usart.c file
+ *  
+ * Contains the pin configurations for the RTS/CTS hardware flow control.
+ * change this file when needed to suit the Avr controller and the board
+ ************************************************************************/
+#ifndef _USART_PIN_CONFIG_H_
+#define _USART_PIN_CONFIG_H_
+
+#include <avr/io.h>
+
+/* Set to 1 to use RTS/CTS flow control, both lines are active low as on
+ * the usual USB to serial converters */
+#define USART_FLOW_CONTROL 0
+
+/* RTS output, driven low while the receive ring buffer has room */
+#define USART_RTS_DDR DDRD
+#define USART_RTS_PORT PORTD
+#define USART_RTS_PIN PD4
+
+/* CTS input, the other side pulls it low when it can take data. It has to
+ * be the INT1 pin, so a change of CTS restarts the transmitter at once */
+#define USART_CTS_DDR DDRD
+#define USART_CTS_PORT PORTD
+#define USART_CTS_PIN_REG PIND
+#define USART_CTS_PIN PD3
+
+/* Fill levels of the receive ring buffer. RTS goes high (stop) at the high
+ * water mark, which leaves room for the bytes the other side still sends
+ * before it reacts, and low again once the buffer is read down to the low
+ * water mark */
+#define USART_RTS_HIGH_WATER (USART_RX_BUFFER_SIZE - 16)
+#define USART_RTS_LOW_WATER (USART_RX_BUFFER_SIZE / 4)
+
+#endif
@@ -0,0 +1,215 @@
+/*
+ * File : filter.c
+ *
+ * Description:
+ * File contains integer only filters for streams of ADC samples
+ *
+ * Note:
+ * For detail documentation about the different filters refer the header
+ * file filter.h
+ * Refer to E:/Avrprojects/library/coding standards.doc for coding standards
+ *
+ */
+
+#include <stdint.h>
+#include "filter.h"
+
+/* Swaps two values if the first one is the bigger one */
+#define SortPair(a,b) do { \
+        if ((a) > (b)) { uint16_t _t = (a); (a) = (b); (b) = _t; } \
+    } while(0)
+
+/*
+ * Function: MovingAverageInit()
+ *
+ * Description: Fills the history with the initial value. For more details
+ * see filter.h
+ *
+ * Returns: Nothing
+ */
+void MovingAverageInit(MOVING_AVERAGE *filter, uint8_t shift, uint16_t initial)
+{
+    uint8_t i;
+
+    if (shift > MOVING_AVERAGE_MAX_SHIFT)
+    {
+        shift = MOVING_AVERAGE_MAX_SHIFT;
+    }
+
+    for (i = 0; i < (1 << shift); i++)
+    {
+        filter->history[i] = initial;
+    }
+    filter->sum = (uint32_t)initial << shift;
+    filter->index = 0;
+    filter->shift = shift;
+}
+
+/*
+ * Function: MovingAverageUpdate()
+ *
+ * Description: Replaces the oldest sample in the running sum with the new
+ * one, so the cost does not depend on the window length
+ *
+ * Returns: The average over the window
+ */
+uint16_t MovingAverageUpdate(MOVING_AVERAGE *filter, uint16_t sample)
+{
+    uint8_t index = filter->index;
+
+    filter->sum -= filter->history[index];
+    filter->sum += sample;
+    filter->history[index] = sample;
+    filter->index = (index + 1) & ((1 << filter->shift) - 1);
+
+    return (uint16_t)(filter->sum >> filter->shift);
+}
+
+void MovingAverageBuffer(MOVING_AVERAGE *filter, uint16_t *samples, uint8_t count)
+{
+    while (count--)
+    {
+        *samples = MovingAverageUpdate(filter, *samples);
+        samples++;
+    }
+}
+
+/*
+ * Function: IirInit()
+ *
+ * Description: Sets the state so that the output starts at the initial
+ * value. For more details see filter.h
+ *
+ * Returns: Nothing
+ */
+void IirInit(IIR_FILTER *filter, uint8_t shift, uint16_t initial)
+{
+    if (shift == 0)
+    {
+        shift = 1;
+    }
+    else if (shift > 16)
+    {
+        shift = 16;
+    }
+    filter->shift = shift;
+    filter->state = (uint32_t)initial << shift;
+}
+
+/*
+ * Function: IirUpdate()
+ *
+ * Description: state holds y * 2^shift, so y += (x - y) / 2^shift becomes
+ * state += x - state / 2^shift without any division
+ *
+ * Returns: The filtered value
+ */
+uint16_t IirUpdate(IIR_FILTER *filter, uint16_t sample)
+{
+    uint8_t shift = filter->shift;
+
+    filter->state = filter->state - (filter->state >> shift) + sample;
+    return (uint16_t)((filter->state + ((uint32_t)1 << (shift - 1))) >> shift);
+}
+
+void IirBuffer(IIR_FILTER *filter, uint16_t *samples, uint8_t count)
+{
+    while (count--)
+    {
+        *samples = IirUpdate(filter, *samples);
+        samples++;
+    }
+}
+
+uint16_t Median3(uint16_t a, uint16_t b, uint16_t c)
+{
+    SortPair(a, b);
+    /* a <= b, the median is b clamped to c from above and a from below */
+    if (c < b)
+    {
+        b = (c > a) ? c : a;
+    }
+    return b;
+}
+
+/*
+ * Function: Median5()
+ *
+ * Description: Median of five with six compares. Twice the smallest of four
+ * values is found and dropped, it can not be the median. The median is then
+ * the smallest of the three values left.
+ *
+ * Returns: The median
+ */
+uint16_t Median5(uint16_t a, uint16_t b, uint16_t c, uint16_t d, uint16_t e)
+{
+    uint16_t t;
+
+    SortPair(a, b);
+    SortPair(c, d);
+    if (a > c)
+    {
+        /* Swap the pairs so a is the smallest of a, b, c, d */
+        t = b; b = d; d = t;
+        c = a;
+    }
+    /* a is dropped, e takes its place */
+    a = e;
+    SortPair(a, b);
+    if (a > c)
+    {
+        t = b; b = d; d = t;
+        c = a;
+    }
+    /* a is dropped again, c <= d so the median is the smaller of b and c */
+    return (b < c) ? b : c;
+}
+
+/*
+ * Function: MedianInit()
+ *
+ * Description: Fills the window with the initial value. For more details see
+ * filter.h
+ *
+ * Returns: Nothing
+ */
+void MedianInit(MEDIAN_FILTER *filter, MEDIAN_TAPS taps, uint16_t initial)
+{
+    uint8_t i;
+
+    for (i = 0; i < (MEDIAN_5_TAPS - 1); i++)
+    {
+        filter->window[i] = initial;
+    }
+    filter->taps = (taps == MEDIAN_5_TAPS) ? MEDIAN_5_TAPS : MEDIAN_3_TAPS;
+}
+
+uint16_t MedianUpdate(MEDIAN_FILTER *filter, uint16_t sample)
+{
+    uint16_t *w = filter->window;
+    uint16_t median;
+
+    if (filter->taps == MEDIAN_5_TAPS)
+    {
+        median = Median5(sample, w[0], w[1], w[2], w[3]);
+        w[3] = w[2];
+        w[2] = w[1];
+    }
+    else
+    {
+        median = Median3(sample, w[0], w[1]);
+    }
+    w[1] = w[0];
+    w[0] = sample;
+
+    return median;
+}
+
+void MedianBuffer(MEDIAN_FILTER *filter, uint16_t *samples, uint8_t count)
+{
+    while (count--)
+    {
+        *samples = MedianUpdate(filter, *samples);
+        samples++;
+    }
+}
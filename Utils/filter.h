@@ -0,0 +1,112 @@
+/************************************************************************
+ * Name : filter.h
+ *
+ * Header file for the filter.c file
+ *
+ * Contains integer only filters for streams of ADC samples. None of the
+ * filters uses floats or divisions, the averaging is done with shifts so the
+ * window lengths and the IIR coefficient are powers of two.
+ * All the filters keep their state in a structure owned by the caller, so
+ * any number of channels can be filtered, and can be run one sample at a
+ * time or in place over a buffer (e.g. the one filled by AdcStreamRead()).
+ *
+ * Cost per sample (no loops inside the update functions) :
+ *   Moving average : one add, one subtract and one shift of a 32 bit sum
+ *   IIR            : one add, one subtract and two shifts of a 32 bit state
+ *   Median 3/5     : 3 or 6 compares plus the window shift
+ ************************************************************************/
+
+#ifndef _FILTER_H_
+#define _FILTER_H_
+
+#include <stdint.h>
+
+/* Longest moving average is 2^MOVING_AVERAGE_MAX_SHIFT samples, every
+ * MOVING_AVERAGE structure keeps that many samples so keep it small */
+#define MOVING_AVERAGE_MAX_SHIFT 4
+
+/* Number of taps of the median filter */
+typedef enum median_taps
+{
+    MEDIAN_3_TAPS = 3,
+    MEDIAN_5_TAPS = 5
+}MEDIAN_TAPS;
+
+/* Moving average state, use MovingAverageInit() to set it up */
+typedef struct moving_average
+{
+    uint16_t history[1 << MOVING_AVERAGE_MAX_SHIFT]; /**< last samples, oldest is overwritten */
+    uint32_t sum;   /**< sum of the samples in history */
+    uint8_t index;  /**< slot of the oldest sample */
+    uint8_t shift;  /**< window is 2^shift samples */
+}MOVING_AVERAGE;
+
+/* Single pole IIR state, use IirInit() to set it up. The output is kept
+ * scaled up by 2^shift so no resolution is lost between the updates */
+typedef struct iir_filter
+{
+    uint32_t state;
+    uint8_t shift;
+}IIR_FILTER;
+
+/* Median filter state, use MedianInit() to set it up */
+typedef struct median_filter
+{
+    uint16_t window[MEDIAN_5_TAPS - 1]; /**< previous raw samples, newest first */
+    uint8_t taps;
+}MEDIAN_FILTER;
+
+/** @brief Set up a moving average over 2^shift samples
+ * @param filter The state to set up
+ * @param shift Window length as power of two (0 - MOVING_AVERAGE_MAX_SHIFT)
+ * @param initial Value the history is filled with
+ */
+void MovingAverageInit(MOVING_AVERAGE *filter, uint8_t shift, uint16_t initial);
+
+/** @brief Add one sample to the moving average
+ * @return the average of the last 2^shift samples
+ */
+uint16_t MovingAverageUpdate(MOVING_AVERAGE *filter, uint16_t sample);
+
+/** @brief Run the moving average in place over a buffer of samples */
+void MovingAverageBuffer(MOVING_AVERAGE *filter, uint16_t *samples, uint8_t count);
+
+/** @brief Set up a single pole IIR low pass y += (x - y) / 2^shift
+ *
+ * The time constant is about 2^shift samples
+ * @param filter The state to set up
+ * @param shift Coefficient as power of two (1 - 16)
+ * @param initial Value the output starts from
+ */
+void IirInit(IIR_FILTER *filter, uint8_t shift, uint16_t initial);
+
+/** @brief Feed one sample through the IIR filter
+ * @return the filtered value, rounded
+ */
+uint16_t IirUpdate(IIR_FILTER *filter, uint16_t sample);
+
+/** @brief Run the IIR filter in place over a buffer of samples */
+void IirBuffer(IIR_FILTER *filter, uint16_t *samples, uint8_t count);
+
+/** @brief Median of three values */
+uint16_t Median3(uint16_t a, uint16_t b, uint16_t c);
+
+/** @brief Median of five values, takes six compares */
+uint16_t Median5(uint16_t a, uint16_t b, uint16_t c, uint16_t d, uint16_t e);
+
+/** @brief Set up a 3 or 5 tap median filter
+ * @param filter The state to set up
+ * @param taps Number of taps
+ * @param initial Value the window is filled with
+ */
+void MedianInit(MEDIAN_FILTER *filter, MEDIAN_TAPS taps, uint16_t initial);
+
+/** @brief Feed one sample through the median filter
+ * @return the median of the sample and the previous taps - 1 samples
+ */
+uint16_t MedianUpdate(MEDIAN_FILTER *filter, uint16_t sample);
+
+/** @brief Run the median filter in place over a buffer of samples */
+void MedianBuffer(MEDIAN_FILTER *filter, uint16_t *samples, uint8_t count);
+
+#endif
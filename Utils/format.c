@@ -0,0 +1,405 @@
+/*
+ * File : format.c
+ *
+ * Description:
+ * File contains the decimal, hex and fixed point formatting used by the
+ * USART and LCD output functions
+ *
+ * Note:
+ * For detail documentation about the functions refer the header file
+ * format.h
+ * Refer to E:/Avrprojects/library/coding standards.doc for coding standards
+ *
+ */
+
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include "format.h"
+
+/* Number of decimal digits in a uint32_t */
+#define FORMAT_MAX_DIGITS 10
+
+/* Powers of ten for the upper digits, only needed above 0xFFFF */
+static const uint32_t format_pow10_32[] PROGMEM =
+{
+    1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL, 10000UL
+};
+
+/* Powers of ten for the lower digits, done with 16 bit arithmetic */
+static const uint16_t format_pow10_16[] PROGMEM =
+{
+    10000, 1000, 100, 10
+};
+
+static const char format_hex_digits[] PROGMEM = "0123456789ABCDEF";
+
+/*
+ * Function: format_digits()
+ *
+ * Description: Writes the decimal digits of value without a '\0'. Each digit
+ * is found by subtracting its power of ten until the rest is smaller, which
+ * is at most 9 compare/subtract steps per digit. Leading zeros are left out
+ * unless they are within the last min_digits places.
+ *
+ * Returns: Number of digits written (at least 1)
+ */
+static uint8_t format_digits(char *digits, uint32_t value, uint8_t min_digits)
+{
+    uint8_t count = 0;
+    uint8_t place = FORMAT_MAX_DIGITS;
+    uint8_t i;
+    uint16_t power;
+    uint16_t rest;
+    char digit;
+
+    if (value > 0xFFFF)
+    {
+        for (i = 0; i < 6; i++, place--)
+        {
+            uint32_t power32 = pgm_read_dword(&format_pow10_32[i]);
+
+            digit = '0';
+            while (value >= power32)
+            {
+                value -= power32;
+                digit++;
+            }
+            if (count || (digit != '0') || (place <= min_digits))
+            {
+                digits[count++] = digit;
+            }
+        }
+        /* The 10000 place is done already */
+        i = 1;
+    }
+    else
+    {
+        /* Nothing to subtract in the upper places */
+        for (; place > 5; place--)
+        {
+            if (place <= min_digits)
+            {
+                digits[count++] = '0';
+            }
+        }
+        i = 0;
+    }
+
+    rest = (uint16_t)value;
+    for (; i < 4; i++, place--)
+    {
+        power = pgm_read_word(&format_pow10_16[i]);
+
+        digit = '0';
+        while (rest >= power)
+        {
+            rest -= power;
+            digit++;
+        }
+        if (count || (digit != '0') || (place <= min_digits))
+        {
+            digits[count++] = digit;
+        }
+    }
+    digits[count++] = '0' + (uint8_t)rest;
+
+    return count;
+}
+
+/*
+ * Function: format_output()
+ *
+ * Description: Copies the sign and the digits into the buffer, padded up to
+ * width. Zero padding goes between the sign and the digits, space padding
+ * in front of the sign.
+ *
+ * Returns: Length of the string
+ */
+static uint8_t format_output(char *buffer, char sign, const char *digits,
+                             uint8_t count, uint8_t width, char pad)
+{
+    uint8_t length = count;
+    uint8_t fill = 0;
+    char *out = buffer;
+
+    if (sign)
+    {
+        length++;
+    }
+    if (width > FORMAT_BUFFER_SIZE - 1)
+    {
+        width = FORMAT_BUFFER_SIZE - 1;
+    }
+    if (width > length)
+    {
+        fill = width - length;
+    }
+
+    if (pad != '0')
+    {
+        for (; fill; fill--)
+        {
+            *out++ = pad;
+        }
+    }
+    if (sign)
+    {
+        *out++ = sign;
+    }
+    for (; fill; fill--)
+    {
+        *out++ = '0';
+    }
+    while (count--)
+    {
+        *out++ = *digits++;
+    }
+    *out = '\0';
+
+    return (uint8_t)(out - buffer);
+}
+
+/*
+ * Function: FormatUnsigned()
+ *
+ * Description: Formats an unsigned number in decimal. For more details see
+ * format.h
+ *
+ * Returns: Length of the string
+ */
+uint8_t FormatUnsigned(char *buffer, uint32_t value, uint8_t width, char pad)
+{
+    char digits[FORMAT_MAX_DIGITS];
+    uint8_t count = format_digits(digits, value, 1);
+
+    return format_output(buffer, 0, digits, count, width, pad);
+}
+
+/*
+ * Function: FormatSigned()
+ *
+ * Description: Formats a signed number in decimal. For more details see
+ * format.h
+ *
+ * Returns: Length of the string
+ */
+uint8_t FormatSigned(char *buffer, int32_t value, uint8_t width, char pad)
+{
+    char digits[FORMAT_MAX_DIGITS];
+    char sign = 0;
+    uint32_t magnitude = (uint32_t)value;
+    uint8_t count;
+
+    if (value < 0)
+    {
+        sign = '-';
+        /* Also right for INT32_MIN */
+        magnitude = 0 - magnitude;
+    }
+    count = format_digits(digits, magnitude, 1);
+
+    return format_output(buffer, sign, digits, count, width, pad);
+}
+
+/*
+ * Function: FormatHex()
+ *
+ * Description: Formats a number in upper case hex. For more details see
+ * format.h
+ *
+ * Returns: Length of the string
+ */
+uint8_t FormatHex(char *buffer, uint32_t value, uint8_t digits)
+{
+    uint8_t place;
+    uint8_t nibble;
+    char *out = buffer;
+
+    if (digits == 0)
+    {
+        digits = 1;
+    }
+
+    for (place = 8; place; place--)
+    {
+        nibble = (uint8_t)(value >> 28);
+        value <<= 4;
+        if ((out != buffer) || nibble || (place <= digits))
+        {
+            *out++ = pgm_read_byte(&format_hex_digits[nibble]);
+        }
+    }
+    *out = '\0';
+
+    return (uint8_t)(out - buffer);
+}
+
+/*
+ * Function: FormatFixed()
+ *
+ * Description: Formats a fixed point number with the decimal point placed
+ * decimals digits from the right. For more details see format.h
+ *
+ * Returns: Length of the string
+ */
+uint8_t FormatFixed(char *buffer, int32_t value, uint8_t decimals, uint8_t width, char pad)
+{
+    char digits[FORMAT_MAX_DIGITS + 1];
+    char sign = 0;
+    uint32_t magnitude = (uint32_t)value;
+    uint8_t count;
+    uint8_t i;
+
+    if (decimals > FORMAT_MAX_DIGITS - 1)
+    {
+        decimals = FORMAT_MAX_DIGITS - 1;
+    }
+    if (value < 0)
+    {
+        sign = '-';
+        magnitude = 0 - magnitude;
+    }
+
+    /* At least one digit in front of the point */
+    count = format_digits(digits, magnitude, decimals + 1);
+
+    if (decimals)
+    {
+        for (i = count; i > count - decimals; i--)
+        {
+            digits[i] = digits[i - 1];
+        }
+        digits[count - decimals] = '.';
+        count++;
+    }
+
+    return format_output(buffer, sign, digits, count, width, pad);
+}
+
+/*
+ * Function: format_put_padded()
+ *
+ * Description: Sends a string to put after padding it with spaces up to
+ * width. The string is in flash if in_flash is set
+ *
+ * Returns: Nothing
+ */
+static void format_put_padded(FORMAT_PUT put, const char *str, bool in_flash, uint8_t width)
+{
+    uint8_t length = 0;
+    const char *end = str;
+    char c;
+
+    if (width)
+    {
+        while ((in_flash ? pgm_read_byte(end) : *end) != '\0')
+        {
+            end++;
+            length++;
+        }
+        for (; width > length; width--)
+        {
+            put(' ');
+        }
+    }
+    while ((c = (in_flash ? pgm_read_byte(str) : *str)) != '\0')
+    {
+        put(c);
+        str++;
+    }
+}
+
+/*
+ * Function: FormatPrint_P()
+ *
+ * Description: Walks the format string in flash and sends the text and the
+ * formatted arguments to put. For more details see format.h
+ *
+ * Returns: Nothing
+ */
+void FormatPrint_P(FORMAT_PUT put, const char *format, va_list args)
+{
+    char buffer[FORMAT_BUFFER_SIZE];
+    char c;
+    char pad;
+    uint8_t width;
+    bool is_long;
+    uint32_t value;
+
+    while ((c = pgm_read_byte(format++)) != '\0')
+    {
+        if (c != '%')
+        {
+            put(c);
+            continue;
+        }
+
+        pad = ' ';
+        width = 0;
+        is_long = false;
+        c = pgm_read_byte(format++);
+        if (c == '0')
+        {
+            pad = '0';
+            c = pgm_read_byte(format++);
+        }
+        while ((c >= '0') && (c <= '9'))
+        {
+            width = width * 10 + (c - '0');
+            c = pgm_read_byte(format++);
+        }
+        if (c == 'l')
+        {
+            is_long = true;
+            c = pgm_read_byte(format++);
+        }
+
+        switch (c)
+        {
+            case 'd':
+                FormatSigned(buffer, is_long ? va_arg(args, int32_t) : va_arg(args, int),
+                             width, pad);
+                format_put_padded(put, buffer, false, 0);
+            break;
+
+            case 'u':
+            case 'x':
+            case 'X':
+                value = is_long ? va_arg(args, uint32_t) : va_arg(args, unsigned int);
+                if (c == 'u')
+                {
+                    FormatUnsigned(buffer, value, width, pad);
+                    format_put_padded(put, buffer, false, 0);
+                }
+                else
+                {
+                    FormatHex(buffer, value, (pad == '0') ? width : 1);
+                    format_put_padded(put, buffer, false, width);
+                }
+            break;
+
+            case 'c':
+                put((char)va_arg(args, int));
+            break;
+
+            case 's':
+                format_put_padded(put, va_arg(args, const char *), false, width);
+            break;
+
+            case 'S':
+                format_put_padded(put, va_arg(args, const char *), true, width);
+            break;
+
+            case '\0':
+                /* A lone % at the end */
+                return;
+
+            default:
+                /* %% and anything not supported is sent as it is */
+                put(c);
+            break;
+        }
+    }
+}
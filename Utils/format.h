@@ -0,0 +1,71 @@
+/************************************************************************
+ * Name : format.h
+ *
+ * Header file for the format.c file
+ *
+ * Contains the number formatting shared by the USART and the LCD output
+ * functions. Decimal digits are found by subtracting powers of ten, so no
+ * division is done (the AVR has no divide instruction and every / or % on an
+ * int16_t is a library call). Numbers that fit 16 bits are done with 16 bit
+ * arithmetic only.
+ ************************************************************************/
+
+#ifndef _FORMAT_H_
+#define _FORMAT_H_
+
+#include <stdint.h>
+#include <stdarg.h>
+
+/* Size of a buffer that takes any formatted number including the '\0',
+ * widths are limited to FORMAT_BUFFER_SIZE - 1 */
+#define FORMAT_BUFFER_SIZE 16
+
+/** @brief Format an unsigned number in decimal
+ * @param buffer At least FORMAT_BUFFER_SIZE bytes, gets a '\0' terminated string
+ * @param value The number to format
+ * @param width Minimum number of characters, 0 for no padding
+ * @param pad Padding character, '0' or ' '
+ * @return the length of the string
+ */
+uint8_t FormatUnsigned(char *buffer, uint32_t value, uint8_t width, char pad);
+
+/** @brief Format a signed number in decimal
+ *
+ * With '0' padding the sign comes before the zeros ("-0042"), with ' '
+ * padding it comes right before the digits ("  -42")
+ * @return the length of the string
+ */
+uint8_t FormatSigned(char *buffer, int32_t value, uint8_t width, char pad);
+
+/** @brief Format a number in upper case hex without any prefix
+ * @param digits Minimum number of digits, filled up with '0'
+ * @return the length of the string
+ */
+uint8_t FormatHex(char *buffer, uint32_t value, uint8_t digits);
+
+/** @brief Format a fixed point number
+ *
+ * The value is the number times 10^decimals, e.g. 1234 with 2 decimals is
+ * formatted as "12.34" and -5 with 2 decimals as "-0.05"
+ * @param decimals Number of digits after the decimal point (up to 9)
+ * @return the length of the string
+ */
+uint8_t FormatFixed(char *buffer, int32_t value, uint8_t decimals, uint8_t width, char pad);
+
+/* Sink for the characters of FormatPrint_P() */
+typedef void (*FORMAT_PUT)(char c);
+
+/** @brief Small printf with the format string in flash
+ *
+ * The format is read with pgm_read_byte() straight from flash and every
+ * character goes to put, nothing is buffered in SRAM. Supported are
+ * %[0][width][l] with d, u, x (upper case hex), c, s (string in RAM),
+ * S (string in flash) and %%. As on the AVR int is 16 bits, 32 bit
+ * numbers need the l. Used by UsartPrintf_P() and LcdPrintf_P().
+ * @param put Function taking each character
+ * @param format Format string in flash, e.g. PSTR("T=%d\r\n")
+ * @param args Arguments for the format
+ */
+void FormatPrint_P(FORMAT_PUT put, const char *format, va_list args);
+
+#endif